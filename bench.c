@@ -0,0 +1,379 @@
+/* SPDX-License-Identifier: ISC */
+
+/*
+ * Micro-benchmarks for parsing, arguments files and the help summary. Build
+ * it the same way as the examples, optionally with `-DCLIP_USE_MMAP`:
+ *
+ *      cc -O2 -o bench bench.c clip.c
+ *      ./bench > before.txt
+ *
+ * Results are printed one per line as `key=value` pairs, so the output of
+ * two builds can be compared by a script, or just `diff`. Every parse timed
+ * must invoke as many call-backs as options are given, else it stops there. Option tables are
+ * made up at run time with 10, 100 and 1000 options and 1, 50 and 500
+ * sub-commands.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "clip.h"
+
+#define MAX_OPTS                        1000
+#define MAX_CMDS                        500
+#define N_ARGS                          256
+#define FILE_LINES                      200000
+#define FILE_NAME                       "bench-args.tmp"
+
+static const struct cli_opt t_switch =
+    CLI_OPT_SWITCH(0, NULL, "A switch that does nothing much at all.");
+
+static const struct cli_opt t_value =
+    CLI_OPT_VALUE(0, NULL, "VALUE", "An option that takes a value.");
+
+static const struct cli_opt t_nargs = CLI_OPT_NARGS("FILE", "Input files.");
+
+static const struct cli_opt t_end = CLI_OPT_END();
+
+static const struct cli_sub_cmd t_cmd_end = CLI_CMD_END();
+
+static const char shorts[] =
+    "abcdefgijklmnopqrstuwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+
+static struct cli_opt opts[MAX_OPTS + 2];
+static char o_names[MAX_OPTS][12];
+static struct cli_sub_cmd base;
+static struct cli_sub_cmd cmds[MAX_CMDS + 1];
+static char c_names[MAX_CMDS][12];
+
+static struct cli_index ix[2];
+static struct cli_key keys[2 * 2 * (MAX_OPTS + 2)];
+static struct cli_cmd_index c_ix;
+static struct cli_cmd_key c_keys[MAX_CMDS + 1];
+
+static struct clip clip;
+static struct clip_state st;
+static struct cli_src srcs[CLIP_FILE_DEPTH];
+
+static char *args[N_ARGS + 2];
+static char a_buf[N_ARGS + 2][24];
+static int n_args;
+
+static char fbuf[8 << 20];
+static char line[CLIP_BUFFER_SIZE];
+static char sbuf[1 << 18];
+static unsigned long n_calls;
+static unsigned long n_runs;
+
+static int cb(
+    const struct clip *clap,
+    const struct cli_sub_cmd *cmd,
+    const struct cli_opt *opt,
+    const char *value)
+{
+    (void)clap;
+    (void)cmd;
+    (void)opt;
+    (void)value;
+
+    n_calls++;
+    return 0;
+}
+
+/**
+ * Make up `n_opts` options shared by the base and `n_cmds` sub-commands,
+ * every other one takes a value.
+ */
+static void make_tables(int n_opts, int n_cmds, int use_idx)
+{
+    int i;
+
+    for (i = 0; i < n_opts; i++) {
+        opts[i] = (i % 2 == 0)? t_switch: t_value;
+        if (i < (int)sizeof(shorts) - 1) {
+            opts[i].a_short = shorts[i];
+        }
+        sprintf(o_names[i], "opt%04d", i);
+        opts[i].a_long = o_names[i];
+    }
+    opts[n_opts]     = t_nargs;
+    opts[n_opts + 1] = t_end;
+
+    base.name = NULL;
+    base.opts = opts;
+    base.cmds = NULL;
+#ifdef CLIP_PACKED
+    base.n_opts = (unsigned short)(n_opts + 1);
+#endif
+    for (i = 0; i < n_cmds; i++) {
+        sprintf(c_names[i], "cmd%03d", i);
+        cmds[i] = base;
+        cmds[i].name = c_names[i];
+    }
+    cmds[n_cmds] = t_cmd_end;
+
+    memset(&clip, 0, sizeof(struct clip));
+    clip.progname = "bench";
+    clip.header   = "Benchmark of a program with far too many options";
+    clip.version  = "1.0";
+    clip.base     = &base;
+    clip.cmds     = cmds;
+    clip.cb       = cb;
+    clip.out      = stdout;
+    clip.width    = 80;
+
+    if (use_idx) {
+        /* Parsing is always in the last sub-command, give it an index too */
+        cli_index_build(&ix[0], &base, keys, cli_index_keys(&base));
+        cli_index_build(
+            &ix[1],
+            &cmds[n_cmds - 1],
+            keys + cli_index_keys(&base),
+            cli_index_keys(&cmds[n_cmds - 1])
+        );
+        cli_cmd_index_build(&c_ix, cmds, c_keys, cli_cmd_index_keys(cmds));
+        clip.idx     = ix;
+        clip.n_idx   = 2;
+        clip.cmd_idx = &c_ix;
+    }
+
+    cli_state_init(&st, &clip);
+}
+
+/**
+ * Fill the arguments vector with `kind` of arguments for the last sub-command
+ * of `n_cmds`, returns how many options they give.
+ */
+static int make_args(const char *kind, int n_opts, int n_cmds)
+{
+    int i, j, k, n;
+
+    n_args = 0;
+    args[n_args++] = "bench";
+    args[n_args++] = c_names[n_cmds - 1];
+
+    n = 0;
+    for (i = 0; i < N_ARGS; i++) {
+        if (strcmp(kind, "short") == 0) {
+            /* Clusters of as many switches as have short names */
+            a_buf[i][0] = '-';
+            for (j = 0, k = 0; k < 8 && j < n_opts; j += 2) {
+                if (j < (int)sizeof(shorts) - 1) {
+                    a_buf[i][1 + k++] = shorts[j];
+                }
+            }
+            a_buf[i][1 + k] = 0;
+            n += k;
+        } else if (strcmp(kind, "long") == 0) {
+            /* Spread over all the options that take a value */
+            sprintf(a_buf[i], "--opt%04d=v", (2 * i + 1) % n_opts);
+            n++;
+        } else {
+            sprintf(a_buf[i], "file%d.c", i);
+            n++;
+        }
+        args[n_args++] = a_buf[i];
+    }
+    args[n_args] = NULL;
+
+    return n;
+}
+
+/**
+ * Run `fn` until it has taken long enough to time, returns the seconds taken
+ * and the number of times it ran in `reps`.
+ */
+static double timed(void (*fn)(void), unsigned long *reps)
+{
+    clock_t t0, t;
+    unsigned long n, i;
+
+    for (n = 1; ; n *= 2) {
+        t0 = clock();
+        for (i = 0; i < n; i++) {
+            fn();
+        }
+        t = clock() - t0;
+
+        if (t >= CLOCKS_PER_SEC / 10) {
+            break;
+        }
+    }
+
+    *reps = n;
+    return (double)t / CLOCKS_PER_SEC;
+}
+
+static void run_parse(void)
+{
+    if (cli_parse_r(&st, n_args, args) != CLIP_ERR_OK) {
+        fprintf(stderr, "bench: parse failed\n");
+        exit(1);
+    }
+    n_runs++;
+}
+
+/**
+ * Time run_parse(), which must invoke call-backs `n_got` times each run.
+ */
+static double timed_parse(const char *what, int n_got, unsigned long *reps)
+{
+    unsigned long calls;
+    double secs;
+
+    calls  = n_calls;
+    n_runs = 0;
+    secs   = timed(run_parse, reps);
+    if (n_calls - calls != n_runs * (unsigned long)n_got) {
+        fprintf(
+            stderr,
+            "bench: %s gave %lu call-backs in %lu runs, not %d each\n",
+            what,
+            n_calls - calls,
+            n_runs,
+            n_got
+        );
+        exit(1);
+    }
+
+    return secs;
+}
+
+static void run_summary(void)
+{
+    if (cli_summary_buf(&clip, NULL, sbuf, sizeof(sbuf), NULL) != 0) {
+        fprintf(stderr, "bench: summary failed\n");
+        exit(1);
+    }
+}
+
+static void bench_parse(void)
+{
+    static const char *const kinds[] = { "short", "long", "nargs" };
+    static const int n_opts[] = { 10, 100, 1000 };
+    static const int n_cmds[] = { 1, 50, 500 };
+    unsigned long reps;
+    double secs;
+    size_t i, j, k;
+    int use_idx, n, n_got;
+
+    for (n = 0; n < 2 * 9 * 3; n++) {
+        use_idx = n / 27;
+        i       = (size_t)(n / 9 % 3);
+        j       = (size_t)(n / 3 % 3);
+        k       = (size_t)(n % 3);
+
+        make_tables(n_opts[i], n_cmds[j], use_idx);
+        n_got = make_args(kinds[k], n_opts[i], n_cmds[j]);
+
+        secs = timed_parse(kinds[k], n_got, &reps);
+        printf(
+            "bench=parse kind=%s opts=%d cmds=%d index=%d ns_per_opt=%.1f\n",
+            kinds[k],
+            n_opts[i],
+            n_cmds[j],
+            use_idx,
+            secs * 1e9 / ((double)reps * n_got)
+        );
+    }
+}
+
+static void bench_file(void)
+{
+    FILE *f;
+    long bytes;
+    unsigned long reps;
+    double secs;
+    int i, buffered;
+
+    make_tables(100, 1, 1);
+
+    if ((f = fopen(FILE_NAME, "w")) == NULL) {
+        fprintf(stderr, "bench: cannot write %s\n", FILE_NAME);
+        return;
+    }
+    for (i = 0; i < FILE_LINES; i++) {
+        if (i % 2 == 0) {
+            fprintf(f, "opt%04d\n", i % 100);
+        } else {
+            fprintf(f, "opt%04d=some/value/%d\n", i % 100, i);
+        }
+    }
+    bytes = ftell(f);
+    fclose(f);
+
+    n_args  = 2;
+    args[0] = "bench";
+    args[1] = "@" FILE_NAME;
+    args[2] = NULL;
+
+    for (buffered = 0; buffered < 2; buffered++) {
+        cli_state_init(&st, &clip);
+        st.srcs   = srcs;
+        st.n_srcs = CLIP_FILE_DEPTH;
+        /* Without room for the whole file, it's read a line at a time */
+        st.fbuf     = buffered? fbuf: line;
+        st.fbuf_len = buffered? sizeof(fbuf): sizeof(line);
+
+        secs = timed_parse("file", FILE_LINES, &reps);
+        printf(
+            "bench=file fbuf=%d lines=%d bytes=%ld mb_per_s=%.1f\n",
+            buffered,
+            FILE_LINES,
+            bytes,
+            (double)bytes * reps / secs / 1e6
+        );
+    }
+
+    remove(FILE_NAME);
+}
+
+static void bench_summary(void)
+{
+    static const int n_opts[] = { 10, 100, 1000 };
+    unsigned long reps;
+    double secs;
+    size_t i, len;
+    int ansi;
+
+    for (i = 0; i < 2 * 3; i++) {
+        ansi = (int)(i / 3);
+        make_tables(n_opts[i % 3], 1, 0);
+        clip.cmds  = NULL;
+        clip.flags = CLIP_FLAG_HELP | CLIP_FLAG_VERSION;
+        if (ansi) {
+            clip.flags |= CLIP_FLAG_USE_ANSI;
+        }
+        cli_summary_buf(&clip, NULL, NULL, 0, &len);
+
+        secs = timed(run_summary, &reps);
+        printf(
+            "bench=summary opts=%d ansi=%d bytes=%lu us_per_render=%.2f\n",
+            n_opts[i % 3],
+            ansi,
+            (unsigned long)len,
+            secs * 1e6 / reps
+        );
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *which;
+
+    which = (argc > 1)? argv[1]: "all";
+    if (strcmp(which, "all") == 0 || strcmp(which, "parse") == 0) {
+        bench_parse();
+    }
+    if (strcmp(which, "all") == 0 || strcmp(which, "file") == 0) {
+        bench_file();
+    }
+    if (strcmp(which, "all") == 0 || strcmp(which, "summary") == 0) {
+        bench_summary();
+    }
+
+    printf("calls=%lu\n", n_calls);
+    return 0;
+}
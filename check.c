@@ -0,0 +1,580 @@
+/* SPDX-License-Identifier: ISC */
+
+/*
+ * Checks of what call-backs are given when parsing command lines and arguments
+ * files and, built with `-DCLIP_USE_MMAP`, cached arguments files. Build it the
+ * same way as the examples:
+ *
+ *      cc -o check check.c clip.c
+ *      ./check
+ *
+ * Each check prints `check=<name> ok`, or what it expected and what it got,
+ * and the exit status is the number of checks that failed. Messages of the
+ * parser go to stderr.
+ */
+
+#if defined(CLIP_USE_MMAP) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE                 200809L
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "clip.h"
+
+#ifdef CLIP_USE_MMAP
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+#define FILE_NAME                       "check-args.tmp"
+#define FILE_TWO                        "check-arg2.tmp"
+#define CACHE_DIR                       "check-cache.tmp"
+
+static char got[1024];
+static char fbuf[4 * CLIP_BUFFER_SIZE];
+static int n_failed;
+
+/**
+ * Note down the option given as `name` or `name=value`, after the name of its
+ * sub-command, if any.
+ */
+static int cb(
+    const struct clip *clap,
+    const struct cli_sub_cmd *cmd,
+    const struct cli_opt *opt,
+    const char *value)
+{
+    char one[128];
+
+    (void)clap;
+
+    one[0] = 0;
+    if (cmd != NULL && cmd->name != NULL) {
+        sprintf(one, "%s:", cmd->name);
+    }
+    if (opt != NULL && opt->a_long != NULL) {
+        strcat(one, opt->a_long);
+    }
+    if (value != NULL) {
+        strcat(one, "=");
+        strncat(one, value, 64);
+    }
+    if (strlen(got) + strlen(one) + 2 < sizeof(got)) {
+        strcat(got, (got[0] != 0)? " ": "");
+        strcat(got, one);
+    }
+
+    return 0;
+}
+
+static void expect(const char *name, int r, int want_r, const char *want)
+{
+    if (r == want_r && strcmp(got, want) == 0) {
+        printf("check=%s ok\n", name);
+        return;
+    }
+
+    printf(
+        "check=%s failed r=%d want_r=%d\n  got:  %s\n  want: %s\n",
+        name,
+        r,
+        want_r,
+        got,
+        want
+    );
+    n_failed++;
+}
+
+/**
+ * Parse the NULL terminated `argv` with `clip` into got.
+ */
+static int parse(struct clip *clip, char **argv)
+{
+    int argc;
+
+    for (argc = 0; argv[argc] != NULL; argc++) {
+        continue;
+    }
+
+    got[0]      = 0;
+    clip->index = 0;
+    return cli_parse(clip, argc, argv);
+}
+
+static void write_file(const char *name, const char *text)
+{
+    FILE *f;
+
+    if ((f = fopen(name, "w")) == NULL) {
+        printf("check: cannot write %s\n", name);
+        n_failed++;
+        return;
+    }
+    fputs(text, f);
+    fclose(f);
+}
+
+static const struct cli_ext key_ext = CLI_EXT_ENV("KEYS");
+
+static struct cli_opt base_opts[] = {
+    CLI_OPT_SWITCH('v', "verbose", "Give more output"),
+    CLI_OPT_VALUE_ATTR('o', "output", "FILE", "Output file",
+        CLI_ATTR_ONCE),
+    CLI_OPT_SWITCH_ATTR('j', "json", "Print JSON", CLI_ATTR_GROUP(1)),
+    CLI_OPT_SWITCH_ATTR('y', "yaml", "Print YAML", CLI_ATTR_GROUP(1)),
+    CLI_OPT_VALUE_ATTR('f', "first", "VALUE", "First wins", CLI_ATTR_FIRST),
+    CLI_OPT_VALUE_ATTR('l', "log", "FILE", "Last wins", CLI_ATTR_LAST),
+    CLI_OPT_LIST('p', "peer", "HOSTS", "Peers to query", ','),
+    CLI_OPT_VALUE_ENV('k', "key", "FILE", "Key file", &key_ext),
+    CLI_OPT_END()
+};
+static struct cli_opt add_opts[] = {
+    CLI_OPT_SWITCH('F', "force", "Overwrite"),
+    CLI_OPT_VALUE_ATTR('u', "url", "URL", "Where from", CLI_ATTR_REQUIRED),
+    CLI_OPT_END()
+};
+static struct cli_opt rm_opts[] = {
+    CLI_OPT_SWITCH('r', "recursive", "Remove directories"),
+    CLI_OPT_END()
+};
+static const struct cli_sub_cmd base_cmd = CLI_CMD(NULL, base_opts);
+static const struct cli_sub_cmd cmd_list[] = {
+    CLI_CMD("add", add_opts),
+    CLI_CMD("rm", rm_opts),
+    CLI_CMD_END()
+};
+
+static void make_clip(struct clip *clip)
+{
+    memset(clip, 0, sizeof(struct clip));
+
+    clip->progname = "check";
+    clip->version  = "1.0";
+    clip->base     = &base_cmd;
+    clip->cmds     = cmd_list;
+    clip->cb       = cb;
+    clip->out      = stderr;
+    clip->fbuf     = fbuf;
+    clip->fbuf_len = sizeof(fbuf);
+}
+
+static void check_basic(void)
+{
+    static char *argv[] = { "c", "rm", "-r", "-v", "--output=a", NULL };
+    struct clip clip;
+    int r;
+
+    make_clip(&clip);
+    r = parse(&clip, argv);
+    expect("basic", r, CLIP_ERR_OK, "rm:recursive verbose output=a");
+}
+
+static void check_attrs(void)
+{
+    static char *ok[] = { "c", "add", "-u", "x", "-j", NULL };
+    static char *missing[] = { "c", "add", "-F", NULL };
+    static char *twice[] = { "c", "-o", "a", "-o", "b", "rm", NULL };
+    static char *group[] = { "c", "-j", "-y", "rm", NULL };
+    struct clip clip;
+    int r;
+
+    make_clip(&clip);
+    r = parse(&clip, ok);
+    expect("attr_ok", r, CLIP_ERR_OK, "add:url=x json");
+    r = parse(&clip, missing);
+    expect("attr_required", r, CLIP_ERR_BAD_ARG, "add:force");
+    r = parse(&clip, twice);
+    expect("attr_once", r, CLIP_ERR_BAD_ARG, "output=a");
+    r = parse(&clip, group);
+    expect("attr_group", r, CLIP_ERR_BAD_ARG, "json");
+}
+
+static void check_complete(void)
+{
+    static char *argv[] = {
+        "c", "--clip-complete", "2", "c", "add", "--f", NULL
+    };
+    struct clip clip;
+    int r;
+
+    /* What's printed goes to stdout, only that nothing's invoked is checked */
+    make_clip(&clip);
+    clip.flags = CLIP_FLAG_COMPLETE;
+    r = parse(&clip, argv);
+    expect("complete", r, CLIP_ERR_HELP, "");
+}
+
+static void check_list(void)
+{
+    static char *argv[] = { "c", "--peer=a,,bb", "-p", "c", NULL };
+    struct clip clip;
+    int r;
+
+    make_clip(&clip);
+    r = parse(&clip, argv);
+    expect("list_elements", r, CLIP_ERR_OK, "peer=a peer=bb peer=c");
+
+    /* With no room for a copy, a plain cb can't be given the elements */
+    clip.fbuf_len = CLIP_BUFFER_SIZE;
+    r = parse(&clip, argv);
+    expect("list_no_room", r, CLIP_ERR_BAD_ARG, "");
+}
+
+static void check_sections(void)
+{
+    static char *add[] = { "c", "add", "@" FILE_NAME, NULL };
+    static char *rm[] = { "c", "rm", "@" FILE_NAME, NULL };
+    struct clip clip;
+    int r;
+
+    write_file(
+        FILE_NAME,
+        "# Given to every sub-command\n"
+        "verbose\n"
+        "\n"
+        "[add]\n"
+        "url=\"https://example.com/a b\"\n"
+        "\n"
+        "[rm]\n"
+        "recursive\n"
+    );
+
+    make_clip(&clip);
+    r = parse(&clip, add);
+    expect("section_add", r, CLIP_ERR_OK,
+        "verbose add:url=https://example.com/a b");
+    r = parse(&clip, rm);
+    expect("section_rm", r, CLIP_ERR_OK, "verbose rm:recursive");
+    remove(FILE_NAME);
+}
+
+struct typed {
+    long port;
+    size_t cache;
+    unsigned long timeout;
+    unsigned flags;
+};
+
+static const struct cli_ext typed_ext[] = {
+    CLI_EXT_TYPED(struct typed, port, 1, 65535),
+    CLI_EXT_TYPED(struct typed, cache, 0, 0),
+    CLI_EXT_TYPED(struct typed, timeout, 0, 0),
+    CLI_EXT_BITS(struct typed, flags, 4)
+};
+
+static struct cli_opt typed_opts[] = {
+    CLI_OPT_INT('p', "port", "N", "Port", &typed_ext[0]),
+    CLI_OPT_SIZE('c', "cache", "SIZE", "Cache", &typed_ext[1]),
+    CLI_OPT_DURATION('t', "timeout", "TIME", "Timeout", &typed_ext[2]),
+    CLI_OPT_FLAG_SET('n', "dry-run", "Do nothing", &typed_ext[3]),
+    CLI_OPT_END()
+};
+static const struct cli_sub_cmd typed_cmd = CLI_CMD(NULL, typed_opts);
+
+static void check_typed(void)
+{
+    static char *argv[] = {
+        "c", "-p", "70", "--port=0x50", "-c", "2k", "-t", "1m", "-n", NULL
+    };
+    static char *range[] = { "c", "-p", "70000", NULL };
+    struct typed t;
+    struct clip clip;
+    int r;
+
+    make_clip(&clip);
+    clip.base = &typed_cmd;
+    clip.cmds = NULL;
+    memset(&t, 0, sizeof(t));
+    clip.usr = &t;
+    r = parse(&clip, argv);
+    if (t.port != 80 || t.cache != 2048 || t.timeout != 60000 ||
+        t.flags != 4) {
+        sprintf(
+            got,
+            "port=%ld cache=%lu timeout=%lu flags=%u",
+            t.port,
+            (unsigned long)t.cache,
+            t.timeout,
+            t.flags
+        );
+    }
+    expect("typed", r, CLIP_ERR_OK, "");
+    r = parse(&clip, range);
+    expect("typed_range", r, CLIP_ERR_BAD_ARG, "");
+
+    /* Without somewhere to store it, a typed option can't be given */
+    clip.usr = NULL;
+    r = parse(&clip, argv);
+    expect("typed_no_usr", r, CLIP_ERR_INVALID, "");
+}
+
+static void check_feed(void)
+{
+    static const char *args[] = { "@" FILE_NAME, "@" FILE_TWO, "@" FILE_NAME };
+    struct cli_src srcs[2];
+    struct cli_file files[4];
+    struct cli_token toks[8];
+    unsigned char marks[CLIP_MARKS(16)];
+    struct clip_state st;
+    struct clip clip;
+    size_t i;
+    int r;
+
+    /* Both names are the same length, and the line holds only the last */
+    write_file(FILE_NAME, "verbose\n");
+    write_file(FILE_TWO, "output=two\n");
+
+    make_clip(&clip);
+    clip.toks   = toks;
+    clip.n_toks = 8;
+    cli_state_init(&st, &clip);
+    st.srcs    = srcs;
+    st.n_srcs  = 2;
+    st.files   = files;
+    st.n_files = 4;
+    st.marks   = marks;
+    st.n_marks = sizeof(marks);
+    got[0] = 0;
+    r = cli_feed_begin(&st);
+    for (i = 0; r == CLIP_ERR_OK && i < sizeof(args) / sizeof(args[0]); i++) {
+        r = cli_feed(&st, args[i], strlen(args[i]));
+    }
+    if (r == CLIP_ERR_OK) {
+        r = cli_feed_end(&st);
+    }
+    expect("feed_files", r, CLIP_ERR_OK, "verbose output=two verbose");
+    remove(FILE_NAME);
+    remove(FILE_TWO);
+}
+
+static void check_hold(void)
+{
+    static char *argv[] = {
+        "c", "-f", "a", "-l", "x", "-v", "-f", "b", "-l", "y", NULL
+    };
+    static char *full[] = { "c", "-f", "a", "-l", "x", "-l", "y", NULL };
+    struct cli_token hold[1];
+    unsigned char marks[CLIP_MARKS(16)];
+    struct clip_state st;
+    struct clip clip;
+    int r;
+
+    make_clip(&clip);
+    r = parse(&clip, argv);
+    expect("hold_first_last", r, CLIP_ERR_OK, "verbose first=a log=y");
+
+    /* With the first held, the last can't be, and isn't given twice */
+    cli_state_init(&st, &clip);
+    st.hold    = hold;
+    st.n_hold  = 1;
+    st.marks   = marks;
+    st.n_marks = sizeof(marks);
+    got[0]     = 0;
+    r = cli_parse_r(&st, 7, full);
+    expect("hold_full", r, CLIP_ERR_BAD_ARG, "");
+}
+
+static void check_dispatch(void)
+{
+    static char *argv[] = { "c", "-f", "a", "-f", "b", "-l", "x", NULL };
+    struct cli_token toks[8], hold[4];
+    unsigned char marks[CLIP_MARKS(16)];
+    struct clip_state st;
+    struct clip clip;
+    size_t n;
+    int r;
+
+    make_clip(&clip);
+    cli_state_init(&st, &clip);
+    st.hold    = hold;
+    st.n_hold  = 4;
+    st.marks   = marks;
+    st.n_marks = sizeof(marks);
+    r = cli_tokenize(&st, 7, argv, toks, 8, &n);
+    if (r == CLIP_ERR_OK) {
+        got[0] = 0;
+        r = cli_dispatch(&st, toks, n);
+        expect("dispatch", r, CLIP_ERR_OK, "first=a log=x");
+        got[0] = 0;
+        r = cli_dispatch(&st, toks, n);
+        expect("dispatch_again", r, CLIP_ERR_OK, "first=a log=x");
+    } else {
+        expect("tokenize", r, CLIP_ERR_OK, "");
+    }
+    cli_end(&st);
+}
+
+#ifdef CLIP_USE_MMAP
+/**
+ * Remove the caches written to CACHE_DIR, and the directory, returns how many
+ * there were.
+ */
+static int clear_cache(void)
+{
+    char name[sizeof(CACHE_DIR) + 256];
+    struct dirent *de;
+    DIR *dir;
+    int n;
+
+    n = 0;
+    if ((dir = opendir(CACHE_DIR)) == NULL) {
+        return 0;
+    }
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] != '.' && strlen(de->d_name) < 256) {
+            sprintf(name, "%s/%s", CACHE_DIR, de->d_name);
+            n += remove(name) == 0;
+        }
+    }
+    closedir(dir);
+    rmdir(CACHE_DIR);
+
+    return n;
+}
+
+static void check_cache(void)
+{
+    static char *argv[] = { "c", "add", "@" FILE_NAME, "-v", NULL };
+    static const char *want = "add:force add:url=u/v verbose";
+    struct utimbuf old;
+    struct clip clip;
+    int r;
+
+    write_file(FILE_NAME, "[add]\nforce\nurl=u/v\n");
+    /* Files changed within the last second aren't cached */
+    old.actime  = 1000000000;
+    old.modtime = 1000000000;
+    utime(FILE_NAME, &old);
+    clear_cache();
+    mkdir(CACHE_DIR, 0700);
+
+    make_clip(&clip);
+    clip.cache_dir = CACHE_DIR;
+    r = parse(&clip, argv);
+    expect("cache_write", r, CLIP_ERR_OK, want);
+    r = parse(&clip, argv);
+    expect("cache_read", r, CLIP_ERR_OK, want);
+
+    got[0] = 0;
+    if (clear_cache() != 1) {
+        strcpy(got, "no cache written");
+    }
+    expect("cache_file", CLIP_ERR_OK, CLIP_ERR_OK, "");
+    remove(FILE_NAME);
+}
+#endif
+
+static void check_no_fbuf(void)
+{
+    static char *argv[] = { "c", "rm", "@" FILE_NAME, NULL };
+    struct clip clip;
+    int r;
+
+    write_file(FILE_NAME, "verbose\nrecursive\n");
+
+    /* cli_parse() reads a line at a time into a buffer of its own */
+    make_clip(&clip);
+    clip.fbuf     = NULL;
+    clip.fbuf_len = 0;
+    r = parse(&clip, argv);
+#if CLIP_PARSE_BUFFER > 0
+    expect("no_fbuf", r, CLIP_ERR_OK, "verbose rm:recursive");
+#else
+    expect("no_fbuf", r, CLIP_ERR_BAD_ARG, "");
+#endif
+    remove(FILE_NAME);
+}
+
+static void check_marks(void)
+{
+    static char *argv[] = { "c", "add", "-u", "x", "-j", "-j", NULL };
+    unsigned char marks[CLIP_MARKS(8)];
+    struct clip_state st;
+    struct clip clip;
+    int r;
+
+    /* Marks the size of the largest table, and a group given twice by one */
+    make_clip(&clip);
+    cli_state_init(&st, &clip);
+    st.marks   = marks;
+    st.n_marks = sizeof(marks);
+    got[0]     = 0;
+    r = cli_parse_r(&st, 6, argv);
+    expect("marks", r, CLIP_ERR_OK, "add:url=x json json");
+
+    /* Options with attributes can't go unmarked */
+    cli_state_init(&st, &clip);
+    got[0] = 0;
+    r = cli_parse_r(&st, 6, argv);
+    expect("marks_none", r, CLIP_ERR_BAD_ARG, "");
+}
+
+static void check_env(void)
+{
+    static char *envp[] = {
+        "PATH=/bin", "CHECK_LOG=env", "CHECK_VERBOSE=0", "CHECK_KEYS=k.txt",
+        "CHECK_JSON=1", NULL
+    };
+    static char *argv[] = { "c", "-l", "arg", "-y", NULL };
+    static char *none[] = { "c", "-v", NULL };
+    static char *more[] = { "CHECK_VERBOSE=1", NULL };
+    unsigned char marks[CLIP_MARKS(16)];
+    struct cli_token hold[4];
+    struct clip_state st;
+    struct clip clip;
+    int i, r;
+
+    make_clip(&clip);
+    clip.env_prefix = "CHECK_";
+    clip.envp       = envp;
+    r = parse(&clip, argv);
+    expect("env_after_args", r, CLIP_ERR_OK, "yaml key=k.txt log=arg");
+
+    /* Fed arguments come first all the same */
+    cli_state_init(&st, &clip);
+    st.hold    = hold;
+    st.n_hold  = 4;
+    st.marks   = marks;
+    st.n_marks = sizeof(marks);
+    got[0]     = 0;
+    r = cli_feed_begin(&st);
+    for (i = 1; r == CLIP_ERR_OK && argv[i] != NULL; i++) {
+        r = cli_feed(&st, argv[i], strlen(argv[i]));
+    }
+    if (r == CLIP_ERR_OK) {
+        r = cli_feed_end(&st);
+    }
+    expect("env_after_feed", r, CLIP_ERR_OK, "yaml key=k.txt log=arg");
+
+    /* Without marks, what the environment gives can't be told apart */
+    clip.envp = more;
+    cli_state_init(&st, &clip);
+    got[0] = 0;
+    r = cli_parse_r(&st, 2, none);
+    expect("env_no_marks", r, CLIP_ERR_BAD_ARG, "verbose");
+}
+
+int main(void)
+{
+    check_basic();
+    check_attrs();
+    check_complete();
+    check_list();
+    check_sections();
+    check_typed();
+    check_feed();
+    check_hold();
+    check_dispatch();
+#ifdef CLIP_USE_MMAP
+    check_cache();
+#endif
+    check_no_fbuf();
+    check_marks();
+    check_env();
+
+    printf("failed=%d\n", n_failed);
+    return n_failed;
+}
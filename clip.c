@@ -1,18 +1,82 @@
 /* SPDX-License-Identifier: ISC */
 
+/* Memory mapped files and their caches need POSIX, even in strict ISO C */
+#if defined(CLIP_USE_MMAP) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE                 200809L
+#endif
+
 #include <stddef.h>
 
 #include <assert.h>
 
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "clip.h"
 
+#ifdef CLIP_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <time.h>
+#endif
+
 #define ARG_REQD                        ((unsigned)0x01)
 #define ARG_ANYK                        ((unsigned)0x02)
+#define ARG_LIST                        ((unsigned)0x04)
+
+#define ARG_TYPE                        ((unsigned)0xF0)
+#define TYPE_INT                        ((unsigned)0x10)
+#define TYPE_SIZE                       ((unsigned)0x20)
+#define TYPE_DURATION                   ((unsigned)0x30)
+#define TYPE_FLAGS                      ((unsigned)0x40)
+
+#define AUTO_H                          ((unsigned)0x01)
+#define AUTO_HELP                       ((unsigned)0x02)
+#define AUTO_V                          ((unsigned)0x04)
+#define AUTO_VERSION                    ((unsigned)0x08)
+
+#define SRC_BLOCK                       0
+#define SRC_LINES                       1
+#define SRC_REPLAY                      2
+#define SRC_CHUNKS                      3
+#define SRC_CACHE                       4
+
+/* Nothing to give out yet, not one of CLIP_ERR_* */
+#define NEXT_NONE                       3
+
+/* Count what parsing does in `st->stats`, if built in and set */
+#ifdef CLIP_STATS
+#define STAT_ADD(st, field, n) \
+    (((st) != NULL && (st)->stats != NULL)? \
+        (void)((st)->stats->field += (n)): (void)0)
+#else
+#define STAT_ADD(st, field, n)          ((void)(st))
+#endif
+
+#define HELP_WIDTH                      80
+#define HELP_WIDE                       100
+#define HELP_COLUMN                     32
+
+#define ATTR_BITS                       8
+#define ENV_NAME                        128
+#define CACHE_NAME                      256
+#define CACHE_BASE                      (~(~0UL >> 1))
+#define CACHE_NONE                      (~0UL)
+#define CACHE_ALIGN(n) \
+    (((n) + sizeof(unsigned long) - 1) / sizeof(unsigned long) * \
+        sizeof(unsigned long))
+#define ATTR_HOLD                       (CLI_ATTR_LAST | CLI_ATTR_FIRST)
+#define ATTR_GROUP(opt)                 (((opt)->attr >> 8) & 0xFF)
+#define OPT_ENV(opt)                    ((opt)->ext? (opt)->ext->env: NULL)
+#define OPT_CB(opt)                     ((opt)->ext? (opt)->ext->cb: NULL)
+#define OPT_SEP(opt)                    ((int)(((opt)->mode >> 8) & 0xFF))
+#define MARK_SEEN                       0
+#define MARK_GIVEN                      1
 
 #define ANSI_END                        "\033[0m"
 #define ANSI_PROG                       "\033[1m\033[1;37m"
@@ -22,7 +86,11 @@
 #define ANSI_ANY                        "\033[1;33m"
 #define ANSI_ERR                        "\033[0;31m"
 
-#define IS_OPT_END(opt) \
+#ifdef CLIP_PACKED
+#define IS_OPT_END(cmd, opt) \
+    ((size_t)((opt) - (cmd)->opts) >= (cmd)->n_opts)
+#else
+#define IS_OPT_END(cmd, opt) \
     ( \
         opt->a_short == 0 && \
         opt->a_long == NULL && \
@@ -30,6 +98,10 @@
         opt->mode == 0 && \
         opt->help == NULL \
     )
+#endif
+
+#define IS_SWITCH(opt) \
+    (((opt)->mode & (ARG_REQD | ARG_ANYK)) == 0)
 
 #define IS_CMD_END(cmd) \
     ( \
@@ -44,14 +116,25 @@
     )
 
 #define IS_SHORT_OPT(v) \
-    ((v)[0] == '-' && isalnum((v)[1]))
+    ((v)[0] == '-' && isalnum((unsigned char)(v)[1]))
 
 #define IS_LONG_OPT(v) \
-    ((v)[0] == '-' && (v)[1] == '-' && isalnum((v)[2]))
+    ((v)[0] == '-' && (v)[1] == '-' && isalnum((unsigned char)(v)[2]))
+
+/* Codes of long-only options may be past a char, which isalnum() can't take */
+#define IS_SHORT_NAME(c) \
+    ((c) > 0 && (c) <= UCHAR_MAX && isalnum((unsigned char)(c)))
 
 #define IS_DOUBLE_DASH(v) \
     ((v)[0] == '-' && (v)[1] == '-' && (v)[2] == 0)
 
+#define IS_SLICE(st) \
+    ( \
+        ((st)->clip->flags & CLIP_FLAG_SLICE) != 0 && \
+        (st)->argv != NULL && \
+        !(st)->feed \
+    )
+
 static const struct cli_opt def_help_base =
     CLI_OPT_SWITCH(
         'h',
@@ -59,13 +142,20 @@ static const struct cli_opt def_help_base =
         "Show help message."
     );
 
-static struct cli_opt def_version =
+static const struct cli_opt def_version =
     CLI_OPT_SWITCH(
         'v',
         "version",
         "Show version and if available, copyright information."
     );
 
+static const struct cli_opt def_version_long =
+    CLI_OPT_SWITCH(
+        0,
+        "version",
+        "Show version and if available, copyright information."
+    );
+
 static const struct cli_opt def_help_cmds =
     CLI_OPT_SWITCH(
         'h',
@@ -74,25 +164,92 @@ static const struct cli_opt def_help_cmds =
         "then a help message specific to that sub-command is shown."
     );
 
+/**
+ * Where a summary goes, `buf` is filled and then written out to `out` in one
+ * go. With no `out`, what doesn't fit in `buf` is only counted in `len`, and
+ * with no `buf` everything goes straight to `out`.
+ */
+struct cli__sink {
+    FILE *out;
+    char *buf;
+    size_t size;
+    size_t used;
+    size_t len;
+};
+
+static void cli__put(struct cli__sink *sk, const char *str, size_t n)
+{
+    size_t room;
+
+    sk->len += n;
+    if (sk->size == 0) {
+        if (sk->out != NULL && n > 0) {
+            fwrite(str, 1, n, sk->out);
+        }
+        return;
+    }
+    while (n > 0) {
+        if (sk->used == sk->size) {
+            if (sk->out == NULL) {
+                return;
+            }
+            fwrite(sk->buf, 1, sk->used, sk->out);
+            sk->used = 0;
+        }
+
+        room = sk->size - sk->used;
+        if (room > n) {
+            room = n;
+        }
+        memcpy(&sk->buf[sk->used], str, room);
+        sk->used += room;
+        str      += room;
+        n        -= room;
+    }
+}
+
+/**
+ * Have `sk` fill the free part of `st->fbuf`, between whole files read and the
+ * values kept, if that's larger than its own buffer, so that what fits there
+ * is written out with one fwrite().
+ */
+static void cli__sink_fbuf(struct cli__sink *sk, const struct clip_state *st)
+{
+    if (st != NULL && st->fbuf != NULL && st->f_top - st->f_used > sk->size) {
+        sk->buf  = &st->fbuf[st->f_used];
+        sk->size = st->f_top - st->f_used;
+    }
+}
+
+static void cli__put_s(struct cli__sink *sk, const char *str)
+{
+    cli__put(sk, str, strlen(str));
+}
+
+static void cli__put_c(struct cli__sink *sk, char chr)
+{
+    cli__put(sk, &chr, 1);
+}
+
 static void cli__puts(
-    FILE *out,
+    struct cli__sink *sk,
     const char *colour,
     const char *pfx,
     const char *sfx,
     const char *str,
     size_t n)
 {
-    if (colour != NULL) fprintf(out, "%s", colour);
-    if (pfx != NULL) fprintf(out, "%s", pfx);
+    if (colour != NULL) cli__put_s(sk, colour);
+    if (pfx != NULL) cli__put_s(sk, pfx);
 
     if (n != 0) {
-        fprintf(out, "%.*s", (int)n, str);
+        cli__put(sk, str, n);
     } else {
-        fprintf(out, "%s", str);
+        cli__put_s(sk, str);
     }
 
-    if (sfx != NULL) fprintf(out, "%s", sfx);
-    if (colour != NULL) fprintf(out, ANSI_END);
+    if (sfx != NULL) cli__put_s(sk, sfx);
+    if (colour != NULL) cli__put_s(sk, ANSI_END);
 }
 
 /**
@@ -102,11 +259,11 @@ static const struct cli_opt *cli__find_any(const struct cli_sub_cmd *cmd)
 {
     const struct cli_opt *opt;
 
-    if (cmd == NULL) {
+    if (cmd == NULL || cmd->opts == NULL) {
         return NULL;
     }
 
-    for (opt = cmd->opts; !IS_OPT_END(opt); opt++) {
+    for (opt = cmd->opts; !IS_OPT_END(cmd, opt); opt++) {
         if ((opt->mode & ARG_ANYK) != 0) {
             return opt;
         }
@@ -116,83 +273,225 @@ static const struct cli_opt *cli__find_any(const struct cli_sub_cmd *cmd)
 }
 
 /**
- * Simple, unintuitive text-wrap algorithm that chops text at spaces and new
- * lines at about 78 character per line.
+ * Wrap `text` to lines shorter than `width` columns, with each line but the
+ * first that the caller began indented by `indent` spaces, `col` is where the
+ * first line is at. Lines are broken at spaces and where `text` has new
+ * lines, a word too long for a line is given one of its own.
  */
-static void cli__put_text(FILE *out, const char *text)
+static void cli__put_text(
+    struct cli__sink *sk,
+    const char *text,
+    size_t col,
+    size_t indent,
+    size_t width)
 {
-    const char *p, *last, *sp, *nl;
+    const char *w;
+    size_t n;
+    int empty;
 
-    last = sp = p = NULL;
-    nl = text;
-    for (p = text; *p != 0; p++) {
-        if (*p != ' ' && *p != '\t') {
+    empty = 1;
+    while (*text != 0) {
+        if (*text == '\n') {
+            cli__put_c(sk, '\n');
+            col   = 0;
+            empty = 1;
+            text++;
+            continue;
+        } else if (*text == ' ' || *text == '\t') {
+            text++;
             continue;
         }
-        last = sp;
-        sp = p;
 
-        if ((size_t)(sp - nl) > 78) {
-            fprintf(out, "  %.*s\n", (int)(last - nl), nl);
-            nl = last + 1;
+        for (w = text; *text != 0 && !isspace((unsigned char)*text); text++) {
+            /* Find where the word ends */
+        }
+        n = (size_t)(text - w);
+
+        if (!empty && col + 1 + n >= width) {
+            cli__put_c(sk, '\n');
+            col   = 0;
+            empty = 1;
+        }
+
+        if (empty) {
+            for (; col < indent; col++) {
+                cli__put_c(sk, ' ');
+            }
+        } else {
+            cli__put_c(sk, ' ');
+            col++;
         }
+
+        cli__put(sk, w, n);
+        col  += n;
+        empty = 0;
+    }
+
+    if (col > 0) {
+        cli__put_c(sk, '\n');
+    }
+}
+
+/**
+ * Length of the option as cli__put_opt() prints it, sans any colours
+ */
+static size_t cli__opt_len(const struct cli_opt *opt)
+{
+    size_t n, tag;
+
+    tag = (opt->tag != NULL)? strlen(opt->tag): 0;
+    if (opt->mode == ARG_ANYK) {
+        return tag + 3;
     }
 
-    if (p > nl) {
-        fprintf(out, "  %s\n", nl);
+    n = 0;
+    if (IS_SHORT_NAME(opt->a_short)) {
+        n += 2 + ((opt->tag != NULL)? 1 + tag: 0);
+        if (opt->a_long) {
+            n += 2;
+        }
+    }
+    if (opt->a_long) {
+        n += 2 + strlen(opt->a_long) + ((opt->tag != NULL)? 1 + tag: 0);
     }
+
+    return n;
 }
 
 /**
- * Print a single command-line option.
+ * Print a single command-line option. Help is given in a second column if
+ * there's `width` for it, otherwise on lines of its own below.
  */
-static void cli__put_opt(FILE *out, int is_ansi, const struct cli_opt *opt)
+static void cli__put_opt(
+    struct cli__sink *sk,
+    int is_ansi,
+    size_t width,
+    const struct cli_opt *opt)
 {
+    size_t n;
+
     if (opt->mode == ARG_ANYK) {
-        if (is_ansi) fprintf(out, ANSI_ANY);
-        fprintf(out, "%s...", opt->tag);
-        if (is_ansi) fprintf(out, ANSI_END);
+        if (is_ansi) cli__put_s(sk, ANSI_ANY);
+        cli__put_s(sk, opt->tag);
+        cli__put_s(sk, "...");
+        if (is_ansi) cli__put_s(sk, ANSI_END);
     } else {
-        if (is_ansi) fprintf(out, ANSI_OPT);
-        if (isalnum(opt->a_short)) {
-            fprintf(out, "-%c", opt->a_short);
+        if (is_ansi) cli__put_s(sk, ANSI_OPT);
+        if (IS_SHORT_NAME(opt->a_short)) {
+            cli__put_c(sk, '-');
+            cli__put_c(sk, (char)opt->a_short);
             if (opt->tag != NULL) {
-                fprintf(out, " %s", opt->tag);
+                cli__put_c(sk, ' ');
+                cli__put_s(sk, opt->tag);
             }
             if (opt->a_long) {
-                fprintf(out, ", ");
+                cli__put_s(sk, ", ");
             }
         }
         if (opt->a_long) {
-            fprintf(out, "--%s", opt->a_long);
+            cli__put_s(sk, "--");
+            cli__put_s(sk, opt->a_long);
             if (opt->tag != NULL) {
-                fprintf(out, "=%s", opt->tag);
+                cli__put_c(sk, '=');
+                cli__put_s(sk, opt->tag);
             }
         }
-        if (is_ansi) fprintf(out, ANSI_END);
+        if (is_ansi) cli__put_s(sk, ANSI_END);
     }
 
-    fputc('\n', out);
-
     /* Now print the help function in a specific way. */
     if (opt->help == NULL) {
+        cli__put_c(sk, '\n');
+        return;
+    }
+
+    if (width < HELP_WIDE) {
+        cli__put_c(sk, '\n');
+        cli__put_text(sk, opt->help, 0, 2, width);
         return;
     }
 
-    cli__put_text(out, opt->help);
+    /* A long option has its help start on the next line */
+    n = cli__opt_len(opt);
+    if (n + 2 > HELP_COLUMN) {
+        cli__put_c(sk, '\n');
+        n = 0;
+    }
+    cli__put_text(sk, opt->help, n, HELP_COLUMN, width);
+}
+
+/**
+ * The width help is wrapped to, from `clip->width` or $COLUMNS
+ */
+static size_t cli__width(const struct clip *clip)
+{
+    const char *cols;
+    unsigned long n;
+
+    if (clip->width != 0) {
+        return clip->width;
+    }
+
+    cols = getenv("COLUMNS");
+    if (cols != NULL && isdigit((unsigned char)cols[0])) {
+        n = strtoul(cols, NULL, 10);
+        if (n >= HELP_COLUMN && n <= 1024) {
+            return (size_t)n;
+        }
+    }
+
+    return HELP_WIDTH;
 }
 
 #if defined(_DEBUG) && !defined(NDEBUG)
 
 #define _TEST(test, msg)                assert(((void)(msg), !(test)))
 
-static void cmd_verify(const struct cli_sub_cmd *cmd)
+static void cmd_verify(const struct clip *clip, const struct cli_sub_cmd *cmd)
 {
     const struct cli_opt *opt;
     size_t anys;
 
+    if (cmd->opts == NULL) {
+        _TEST(cmd->cmds == NULL, "Sub-command has no options or sub-commands");
+        return;
+    }
+
     anys = 0;
-    for (opt = cmd->opts; !IS_OPT_END(opt); opt++) {
+    for (opt = cmd->opts; !IS_OPT_END(cmd, opt); opt++) {
+        _TEST(
+            OPT_ENV(opt) != NULL && (opt->mode & ARG_ANYK) != 0,
+            "NARGS option can't be taken from the environment"
+        );
+        if (opt->attr != 0) {
+            _TEST(
+                opt - cmd->opts >= CLIP_ATTR_MAX,
+                "Option with attributes is past CLIP_ATTR_MAX"
+            );
+            _TEST(
+                ATTR_GROUP(opt) >= CLIP_GROUP_MAX,
+                "Option group is not less than CLIP_GROUP_MAX"
+            );
+        }
+        if ((opt->mode & ARG_TYPE) != 0) {
+            _TEST(clip->usr == NULL, "Typed option, but `usr` is NULL");
+            _TEST(opt->ext == NULL, "Typed option doesn't say where to store");
+        } else {
+            _TEST(
+                OPT_CB(opt) == NULL && cmd->cb == NULL &&
+                    clip->cb == NULL && clip->cbn == NULL &&
+                    clip->result == NULL,
+                "call-back is NULL"
+            );
+        }
+
+        if ((opt->mode & ARG_LIST) != 0) {
+            _TEST(
+                (opt->mode & ARG_REQD) == 0 || OPT_SEP(opt) == 0,
+                "List option doesn't take a value split at a character"
+            );
+        }
+
         if ((opt->mode & ARG_REQD) != 0) {
             _TEST(
                 opt->tag == NULL,
@@ -220,19 +519,38 @@ static void cmd_verify(const struct cli_sub_cmd *cmd)
         "Too many NARGS option defined"
     );
 }
+
+static void cmds_verify(
+    const struct clip *clip,
+    const struct cli_sub_cmd *cmds,
+    int depth)
+{
+    const struct cli_sub_cmd *cmd;
+
+    _TEST(depth > CLIP_CMD_DEPTH, "Sub-commands nested too deep");
+    for (cmd = cmds; !IS_CMD_END(cmd); cmd++) {
+        _TEST(
+            cmd->name == NULL,
+            "Sub-command doesn't have a name"
+        );
+        cmd_verify(clip, cmd);
+        if (cmd->cmds != NULL) {
+            cmds_verify(clip, cmd->cmds, depth + 1);
+        }
+    }
+}
 #endif
 
 void cli_verify(struct clip *clip)
 {
 #if defined(_DEBUG) && !defined(NDEBUG)
     _TEST(clip == NULL, "`clip` is NULL");
-    _TEST(clip->cb == NULL, "call-back is NULL");
     _TEST(
         clip->base == NULL && clip->cmds == NULL,
         "Must define some options or sub-commands"
     );
     _TEST(
-        (clip->flags && CLIP_FLAG_VERSION) != 0 && clip->version == NULL,
+        (clip->flags & CLIP_FLAG_VERSION) != 0 && clip->version == NULL,
         "Automatic version requested, but no version specified"
     );
     _TEST(
@@ -240,19 +558,11 @@ void cli_verify(struct clip *clip)
         "Base options cannot be a named sub-command"
     );
     if (clip->base != NULL) {
-        cmd_verify(clip->base);
+        cmd_verify(clip, clip->base);
     }
 
     if (clip->cmds != NULL) {
-        const struct cli_sub_cmd *cmd;
-
-        for (cmd = clip->cmds; !IS_CMD_END(cmd); cmd++) {
-            _TEST(
-                cmd->name == NULL,
-                "Sub-command doesn't have a name"
-            );
-            cmd_verify(cmd);
-        }
+        cmds_verify(clip, clip->cmds, 1);
     }
 #else
     (void)clip;
@@ -261,594 +571,4833 @@ void cli_verify(struct clip *clip)
 #endif
 }
 
-static const struct cli_sub_cmd *cli__find_cmd(
-    struct clip *clip,
-    const char *name)
+/**
+ * Compare two keys of given lengths the same way `strcmp()` would.
+ */
+static int cli__key_cmp(
+    const char *a,
+    size_t a_len,
+    const char *b,
+    size_t b_len)
 {
-    size_t c_len, n_len;
-    const struct cli_sub_cmd *cmd;
+    int r;
 
-    if (clip->cmds == NULL) {
-        return NULL;
+    r = memcmp(a, b, (a_len < b_len)? a_len: b_len);
+    if (r == 0) {
+        r = (a_len > b_len) - (a_len < b_len);
     }
 
-    n_len = strlen(name);
-    for (cmd = clip->cmds; !IS_CMD_END(cmd); cmd++) {
-        c_len = strlen(cmd->name);
-        if (n_len == c_len && memcmp(cmd->name, name, n_len) == 0) {
-            return cmd;
-        }
+    return r;
+}
+
+static int cli__key_sort(const void *a, const void *b)
+{
+    const struct cli_key *x = (const struct cli_key *)a;
+    const struct cli_key *y = (const struct cli_key *)b;
+    int r;
+
+    r = cli__key_cmp(x->name, x->len, y->name, y->len);
+    if (r == 0) {
+        /* Both from the same options list, keep the first defined first. */
+        r = (x->opt > y->opt) - (x->opt < y->opt);
     }
 
-    return NULL;
+    return r;
 }
 
-static const struct cli_opt *cli__find_opt_0(
-    const struct cli_sub_cmd *cmd,
-    const char *str)
+size_t cli_index_keys(const struct cli_sub_cmd *cmd)
 {
     const struct cli_opt *opt;
-    size_t s_len, o_len;
+    size_t n;
 
     if (cmd == NULL || cmd->opts == NULL) {
-        return NULL;
+        return 0;
     }
 
-    s_len = strlen(str);
-
-    for (opt = cmd->opts; !IS_OPT_END(opt); opt++) {
-        if ((opt->mode & ARG_ANYK) != 0) {
-            continue;
+    n = 0;
+    for (opt = cmd->opts; !IS_OPT_END(cmd, opt); opt++) {
+        if ((opt->mode & ARG_ANYK) == 0 && opt->a_long != NULL) {
+            n++;
         }
-
-        if (s_len == 1 && str[0] == opt->a_short) {
-            return opt;
-        } else if (s_len > 1 && opt->a_long != NULL) {
-            o_len = strlen(opt->a_long);
-            if (s_len == o_len && memcmp(str, opt->a_long, s_len) == 0) {
-                return opt;
-            }
+        if (OPT_ENV(opt) != NULL) {
+            n++;
         }
     }
 
-    return NULL;
+    return n;
 }
 
-static const struct cli_opt *cli__find_opt(
-    const struct cli_sub_cmd **whence,
-    struct clip *clip,
+int cli_index_build(
+    struct cli_index *idx,
     const struct cli_sub_cmd *cmd,
-    const char *str)
+    struct cli_key *keys,
+    size_t n_keys)
 {
     const struct cli_opt *opt;
+    size_t i, n, e;
+    int chr;
 
-    *whence = cmd;
-    /* Find first in live sub command */
-    if ((opt = cli__find_opt_0(cmd, str)) == NULL && cmd != clip->base) {
-        /* If not, find it in global/base */
-        opt = cli__find_opt_0(clip->base, str);
-        *whence = clip->base;
+    if (idx == NULL || cmd == NULL || cmd->opts == NULL) {
+        return CLIP_ERR_INVALID;
     }
-
-    if (opt == NULL) {
-        *whence = NULL;
+    if (keys == NULL && n_keys != 0) {
+        return CLIP_ERR_INVALID;
     }
-    return opt;
-}
 
-static void cli_bad_arg(
-    FILE *out,
-    unsigned flags,
-    int tag,
-    const char *pfx,
-    const char *key)
-{
-    fprintf(out, "%s ", pfx);
-    if ((flags & CLIP_FLAG_USE_ANSI) != 0) {
-        fprintf(out, ANSI_ERR);
-    }
-    switch (tag) {
-        case 3:
-            fputc('@', out);
-            break;
-        case 2:
-            fputc('-', out);
-            /* fall-through */
-        case 1:
-            fputc('-', out);
-            break;
-    }
-    fprintf(out, "%s", key);
-    if ((flags & CLIP_FLAG_USE_ANSI) != 0) {
-        fprintf(out, ANSI_END);
+    for (i = 0; i < 256; i++) {
+        idx->shorts[i] = NULL;
     }
-    fputc('\n', out);
-}
 
-static int cli_do_file(struct clip *clip, const char *file, size_t n)
-{
-    FILE *f, *out;
-    char buffer[CLIP_BUFFER_SIZE];
-    int r;
-    const struct cli_opt *opt;
-    const struct cli_sub_cmd *cmd;
+    n = 0;
+    for (opt = cmd->opts; !IS_OPT_END(cmd, opt); opt++) {
+        if ((opt->mode & ARG_ANYK) != 0) {
+            continue;
+        }
 
-    out = (clip->out != NULL)? clip->out: stderr;
-    sprintf(buffer, "%.*s", (int)n, file);
+        chr = opt->a_short;
+        if (chr > 0 && chr < 256 && idx->shorts[chr] == NULL) {
+            idx->shorts[chr] = opt;
+        }
 
-    if ((f = fopen(buffer, "r")) == NULL) {
-        fprintf(out, "Arguments file '%s' could not be opened.", buffer);
-        return CLIP_ERR_BAD_ARG;
+        if (opt->a_long != NULL) {
+            if (n >= n_keys) {
+                return CLIP_ERR_INVALID;
+            }
+            keys[n].name = opt->a_long;
+            keys[n].len  = strlen(opt->a_long);
+            keys[n].opt  = opt;
+            n++;
+        }
     }
 
-    r = 0;
-    while(fgets(buffer, CLIP_BUFFER_SIZE, f) != NULL) {
-        char *eq;
-        char *key, *val;
-        char *nl;
-        size_t len;
+    if (n > 1) {
+        qsort(keys, n, sizeof(struct cli_key), cli__key_sort);
+    }
 
-#if defined(_WIN32) || \
-    defined(__WIN32__) || \
-    defined(__WINDOWS__) || \
-    defined(MSDOS) || \
-    defined(__DOS__) || \
-    defined(__MSDOS__) || \
-    defined(_MSDOS)
-        nl = strchr(buffer, '\r');
-        if (nl == NULL) {
-            nl = strchr(buffer, '\n');
+    /* Names of environment variables follow in a sorted run of their own */
+    e = n;
+    for (opt = cmd->opts; !IS_OPT_END(cmd, opt); opt++) {
+        if (OPT_ENV(opt) == NULL) {
+            continue;
         }
-#else
-        nl = strchr(buffer, '\n');
-#endif
-        if (nl != NULL) {
-            *nl = 0;
+        if (e >= n_keys) {
+            return CLIP_ERR_INVALID;
         }
+        keys[e].name = opt->ext->env;
+        keys[e].len  = strlen(opt->ext->env);
+        keys[e].opt  = opt;
+        e++;
+    }
 
-        key = buffer;
-        eq = strchr(buffer, '=');
-        if (eq == NULL) {
-            eq = strchr(buffer, ' ');
-        }
-        val = NULL;
-        if (eq != NULL) {
-            *eq = 0;
-            val = eq + 1;
-        }
+    if (e - n > 1) {
+        qsort(keys + n, e - n, sizeof(struct cli_key), cli__key_sort);
+    }
 
-        opt = cli__find_opt(&cmd, clip, clip->live, key);
-        if (opt == NULL) {
+    idx->cmd    = cmd;
+    idx->keys   = keys;
+    idx->n_keys = n;
+    idx->find   = NULL;
+    idx->envs   = keys + n;
+    idx->n_envs = e - n;
 
-            len = strlen(key);
-            cli_bad_arg(
-                out,
-                clip->flags,
-                len == 1? 1: 2,
-                "Invalid option:",
-                key
-            );
-            r = CLIP_ERR_BAD_ARG;
-            goto done;
-        }
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Find the pre-built index of a sub-command, if there's one.
+ */
+static const struct cli_index *cli__index_of(
+    const struct clip *clip,
+    const struct cli_sub_cmd *cmd)
+{
+    size_t i;
+
+    if (cmd == NULL || clip->idx == NULL) {
+        return NULL;
+    }
 
-        if ((r = clip->cb(clip, cmd, opt, val)) != 0) {
-            r = CLIP_ERR_CB_FAIL;
-            goto done;
+    for (i = 0; i < clip->n_idx; i++) {
+        if (clip->idx[i].cmd == cmd) {
+            return &clip->idx[i];
         }
     }
 
-done:
-    fclose(f);
-    return r;
+    return NULL;
 }
 
-
-int cli_summary(struct clip *clip, const struct cli_sub_cmd *cmd)
+/**
+ * Binary search `n` sorted keys, returns the first defined in case of
+ * duplicates.
+ */
+static const struct cli_opt *cli__key_find(
+    const struct cli_key *keys,
+    size_t n,
+    const char *str,
+    size_t s_len,
+    const struct clip_state *st)
 {
-    FILE *out;
-    const struct cli_opt *any;
+    size_t lo, hi, mid;
+    const struct cli_key *key;
 
-    if (clip == NULL) {
-        return CLIP_ERR_INVALID;
+    lo = 0;
+    hi = n;
+    while (lo < hi) {
+        STAT_ADD(st, compares, 1);
+        mid = lo + (hi - lo) / 2;
+        key = &keys[mid];
+        if (cli__key_cmp(key->name, key->len, str, s_len) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
 
-    if (cmd == NULL) {
-        cmd = clip->base;
+    if (lo < n) {
+        key = &keys[lo];
+        if (key->len == s_len && memcmp(key->name, str, s_len) == 0) {
+            return key->opt;
+        }
     }
 
-    out = (clip->out)? clip->out: stdout;
-    any = cli__find_any(cmd);
+    return NULL;
+}
 
-    fprintf(out, "Usage: ");
-    cli__puts(
-        out,
-        (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_PROG: NULL,
+/**
+ * Look up a short or long option in an index.
+ */
+static const struct cli_opt *cli__index_find(
+    const struct cli_index *idx,
+    const char *str,
+    size_t s_len,
+    const struct clip_state *st)
+{
+    STAT_ADD(st, compares, 1);
+    if (s_len == 1) {
+        return idx->shorts[(unsigned char)str[0]];
+    } else if (idx->find != NULL) {
+        return idx->find(idx, str, s_len);
+    }
+
+    return cli__key_find(idx->keys, idx->n_keys, str, s_len, st);
+}
+
+static int cli__cmd_key_sort(const void *a, const void *b)
+{
+    const struct cli_cmd_key *x = (const struct cli_cmd_key *)a;
+    const struct cli_cmd_key *y = (const struct cli_cmd_key *)b;
+    int r;
+
+    r = cli__key_cmp(x->name, x->len, y->name, y->len);
+    if (r == 0) {
+        r = (x->cmd > y->cmd) - (x->cmd < y->cmd);
+    }
+
+    return r;
+}
+
+size_t cli_cmd_index_keys(const struct cli_sub_cmd *cmds)
+{
+    const struct cli_sub_cmd *cmd;
+    size_t n;
+
+    if (cmds == NULL) {
+        return 0;
+    }
+
+    n = 0;
+    for (cmd = cmds; !IS_CMD_END(cmd); cmd++) {
+        n += 1 + cli_cmd_index_keys(cmd->cmds);
+    }
+
+    return n;
+}
+
+/**
+ * Append one level of sub-commands to the keys and sort them.
+ */
+static int cli__cmd_index_add(
+    const struct cli_sub_cmd *cmds,
+    struct cli_cmd_key *keys,
+    size_t *n,
+    size_t n_keys)
+{
+    const struct cli_sub_cmd *cmd;
+    size_t start;
+
+    start = *n;
+    for (cmd = cmds; !IS_CMD_END(cmd); cmd++) {
+        if (cmd->name == NULL || *n >= n_keys) {
+            return CLIP_ERR_INVALID;
+        }
+        keys[*n].name  = cmd->name;
+        keys[*n].len   = strlen(cmd->name);
+        keys[*n].cmd   = cmd;
+        keys[*n].sub   = 0;
+        keys[*n].n_sub = 0;
+        (*n)++;
+    }
+
+    if (*n - start > 1) {
+        qsort(
+            &keys[start],
+            *n - start,
+            sizeof(struct cli_cmd_key),
+            cli__cmd_key_sort
+        );
+    }
+
+    return CLIP_ERR_OK;
+}
+
+int cli_cmd_index_build(
+    struct cli_cmd_index *idx,
+    const struct cli_sub_cmd *cmds,
+    struct cli_cmd_key *keys,
+    size_t n_keys)
+{
+    size_t i, n;
+
+    if (idx == NULL || cmds == NULL || keys == NULL) {
+        return CLIP_ERR_INVALID;
+    }
+
+    n = 0;
+    if (cli__cmd_index_add(cmds, keys, &n, n_keys) != CLIP_ERR_OK) {
+        return CLIP_ERR_INVALID;
+    }
+    idx->n_top = n;
+
+    /* Breadth first, every nested level is appended as a run of its own. */
+    for (i = 0; i < n; i++) {
+        if (keys[i].cmd->cmds == NULL) {
+            continue;
+        }
+
+        keys[i].sub = n;
+        if (cli__cmd_index_add(keys[i].cmd->cmds, keys, &n, n_keys) != 0) {
+            return CLIP_ERR_INVALID;
+        }
+        keys[i].n_sub = n - keys[i].sub;
+    }
+
+    idx->cmds   = cmds;
+    idx->keys   = keys;
+    idx->n_keys = n;
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Find a sub-command in one level of sub-commands. If `keys` is not NULL, the
+ * sorted run of `n_keys` is binary searched, else `cmds` is walked.
+ */
+static const struct cli_sub_cmd *cli__find_cmd(
+    const struct cli_sub_cmd *cmds,
+    const struct cli_cmd_key *keys,
+    size_t n_keys,
+    const struct cli_cmd_key **found,
+    const char *name,
+    size_t n_len,
+    const struct clip_state *st)
+{
+    size_t c_len;
+    size_t lo, hi, mid;
+    const struct cli_sub_cmd *cmd;
+
+    *found = NULL;
+    if (keys != NULL) {
+        lo = 0;
+        hi = n_keys;
+        while (lo < hi) {
+            STAT_ADD(st, compares, 1);
+            mid = lo + (hi - lo) / 2;
+            if (cli__key_cmp(keys[mid].name, keys[mid].len, name, n_len) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        if (lo < n_keys &&
+            keys[lo].len == n_len &&
+            memcmp(keys[lo].name, name, n_len) == 0) {
+            *found = &keys[lo];
+            return keys[lo].cmd;
+        }
+
+        return NULL;
+    }
+
+    if (cmds == NULL) {
+        return NULL;
+    }
+
+    for (cmd = cmds; !IS_CMD_END(cmd); cmd++) {
+        STAT_ADD(st, compares, 1);
+        STAT_ADD(st, strlens, 1);
+        c_len = strlen(cmd->name);
+        if (n_len == c_len && memcmp(cmd->name, name, n_len) == 0) {
+            return cmd;
+        }
+    }
+
+    return NULL;
+}
+
+static const struct cli_opt *cli__find_opt_0(
+    const struct cli_sub_cmd *cmd,
+    const struct cli_index *idx,
+    const char *str,
+    size_t s_len,
+    const struct clip_state *st)
+{
+    const struct cli_opt *opt;
+    size_t o_len;
+
+    if (cmd == NULL || cmd->opts == NULL || s_len == 0) {
+        return NULL;
+    }
+
+    if (idx != NULL) {
+        return cli__index_find(idx, str, s_len, st);
+    }
+
+    for (opt = cmd->opts; !IS_OPT_END(cmd, opt); opt++) {
+        if ((opt->mode & ARG_ANYK) != 0) {
+            continue;
+        }
+
+        STAT_ADD(st, compares, 1);
+        if (s_len == 1 && str[0] == opt->a_short) {
+            return opt;
+        } else if (s_len > 1 && opt->a_long != NULL) {
+            STAT_ADD(st, strlens, 1);
+            o_len = strlen(opt->a_long);
+            if (s_len == o_len && memcmp(str, opt->a_long, s_len) == 0) {
+                return opt;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static const struct cli_opt *cli__find_opt(
+    const struct cli_sub_cmd **whence,
+    struct clip_state *st,
+    const char *str,
+    size_t s_len)
+{
+    const struct cli_opt *opt;
+
+    *whence = st->live;
+    /* Find first in live sub command */
+    opt = cli__find_opt_0(st->live, st->l_idx, str, s_len, st);
+    if (opt == NULL && st->live != st->clip->base) {
+        /* If not, find it in global/base */
+        opt = cli__find_opt_0(st->clip->base, st->b_idx, str, s_len, st);
+        *whence = st->clip->base;
+    }
+
+    if (opt == NULL) {
+        *whence = NULL;
+    }
+    return opt;
+}
+
+/**
+ * Long options of a sub-command that `str` is a prefix of. With `sk`, each is
+ * printed between `pre` and `post`, else the first is stored at `first`.
+ * Returns how many there are.
+ */
+static size_t cli__prefix_0(
+    const struct cli_sub_cmd *cmd,
+    const struct cli_index *idx,
+    const char *str,
+    size_t s_len,
+    const struct clip_state *st,
+    struct cli__sink *sk,
+    const char *pre,
+    const char *post,
+    const struct cli_opt **first)
+{
+    const struct cli_opt *opt;
+    size_t lo, hi, mid, n;
+
+    if (cmd == NULL || cmd->opts == NULL) {
+        return 0;
+    }
+
+    n = 0;
+    if (idx != NULL) {
+        /* Names starting with `str` are all together, from the first not
+         * sorted before it.
+         */
+        lo = 0;
+        hi = idx->n_keys;
+        while (lo < hi) {
+            STAT_ADD(st, compares, 1);
+            mid = lo + (hi - lo) / 2;
+            if (cli__key_cmp(idx->keys[mid].name, idx->keys[mid].len,
+                             str, s_len) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        for (; lo < idx->n_keys; lo++) {
+            STAT_ADD(st, compares, 1);
+            if (idx->keys[lo].len < s_len ||
+                memcmp(idx->keys[lo].name, str, s_len) != 0) {
+                break;
+            }
+
+            if (sk != NULL) {
+                cli__put_s(sk, pre);
+                cli__put_s(sk, idx->keys[lo].opt->a_long);
+                cli__put_s(sk, post);
+            } else if (n == 0) {
+                *first = idx->keys[lo].opt;
+            }
+            n++;
+        }
+
+        return n;
+    }
+
+    for (opt = cmd->opts; !IS_OPT_END(cmd, opt); opt++) {
+        if ((opt->mode & ARG_ANYK) != 0 || opt->a_long == NULL) {
+            continue;
+        }
+
+        STAT_ADD(st, compares, 1);
+        if (strncmp(opt->a_long, str, s_len) == 0) {
+            if (sk != NULL) {
+                cli__put_s(sk, pre);
+                cli__put_s(sk, opt->a_long);
+                cli__put_s(sk, post);
+            } else if (n == 0) {
+                *first = opt;
+            }
+            n++;
+        }
+    }
+
+    return n;
+}
+
+static void cli_bad_arg(
+    FILE *out,
+    unsigned flags,
+    int tag,
+    const char *pfx,
+    const char *key,
+    size_t n)
+{
+    fprintf(out, "%s ", pfx);
+    if ((flags & CLIP_FLAG_USE_ANSI) != 0) {
+        fprintf(out, ANSI_ERR);
+    }
+    switch (tag) {
+        case 3:
+            fputc('@', out);
+            break;
+        case 2:
+            fputc('-', out);
+            /* fall-through */
+        case 1:
+            fputc('-', out);
+            break;
+    }
+    fprintf(out, "%.*s", (int)n, key);
+    if ((flags & CLIP_FLAG_USE_ANSI) != 0) {
+        fprintf(out, ANSI_END);
+    }
+    fputc('\n', out);
+}
+
+/**
+ * Find an option named by `str`, or with ::CLIP_FLAG_PREFIX, the one option
+ * that `str` is a prefix of. If there's none, that's reported, `tag` being
+ * how `str` was given, as in cli_bad_arg().
+ */
+static const struct cli_opt *cli__match_opt(
+    const struct cli_sub_cmd **whence,
+    struct clip_state *st,
+    const char *str,
+    size_t s_len,
+    int tag)
+{
+    FILE *out;
+    struct cli__sink sk;
+    const struct cli_opt *opt, *base;
+    size_t n, n_base;
+    int use_base, help, version;
+
+    out = (st->clip->out != NULL)? st->clip->out: stderr;
+    opt = cli__find_opt(whence, st, str, s_len);
+    if (opt != NULL) {
+        return opt;
+    }
+
+    if ((st->clip->flags & CLIP_FLAG_PREFIX) == 0 || s_len < 2) {
+        cli_bad_arg(out, st->clip->flags, tag, "Invalid option:", str, s_len);
+        return NULL;
+    }
+
+    use_base = st->live != st->clip->base;
+    opt  = NULL;
+    base = NULL;
+    n    = cli__prefix_0(
+        st->live,
+        st->l_idx,
+        str,
+        s_len,
+        st,
         NULL,
         NULL,
-        clip->progname,
-        0
+        NULL,
+        &opt
     );
+    n_base = 0;
+    if (use_base) {
+        n_base = cli__prefix_0(
+            st->clip->base,
+            st->b_idx,
+            str,
+            s_len,
+            st,
+            NULL,
+            NULL,
+            NULL,
+            &base
+        );
+    }
+
+    /* So --ver isn't taken for --verbose when there's --version too */
+    help    = (st->autos & AUTO_HELP) != 0 &&
+              s_len <= 4 && memcmp(str, "help", s_len) == 0;
+    version = (st->autos & AUTO_VERSION) != 0 &&
+              s_len <= 7 && memcmp(str, "version", s_len) == 0;
+
+    if (n + n_base == 1 && !help && !version) {
+        *whence = (n == 1)? st->live: st->clip->base;
+        return (n == 1)? opt: base;
+    } else if (n + n_base == 0) {
+        cli_bad_arg(out, st->clip->flags, tag, "Invalid option:", str, s_len);
+        return NULL;
+    }
+
+    /* Name all it could have been, written out as they're found */
+    sk.out  = out;
+    sk.buf  = NULL;
+    sk.size = 0;
+    sk.used = 0;
+    sk.len  = 0;
+    fprintf(out, "Ambiguous option: --%.*s, could be", (int)s_len, str);
+    cli__prefix_0(st->live, st->l_idx, str, s_len, st, &sk, " --", "", &opt);
+    if (use_base) {
+        cli__prefix_0(
+            st->clip->base,
+            st->b_idx,
+            str,
+            s_len,
+            st,
+            &sk,
+            " --",
+            "",
+            &base
+        );
+    }
+    if (help) {
+        fprintf(out, " --help");
+    }
+    if (version) {
+        fprintf(out, " --version");
+    }
+    fputc('\n', out);
+
+    *whence = NULL;
+    return NULL;
+}
+
+/**
+ * Parse an unsigned decimal, or `0x` prefixed hexadecimal, number at the start
+ * of `str` of `n` characters. Returns the number of characters used, or 0 if
+ * there's no number or it overflows.
+ */
+static size_t cli__ulong(const char *str, size_t n, unsigned long *v)
+{
+    unsigned long r, base, d;
+    size_t i, start;
+    int c;
+
+    base = 10;
+    i    = 0;
+    if (n > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+        base = 16;
+        i    = 2;
+    }
+
+    r = 0;
+    for (start = i; i < n; i++) {
+        c = (unsigned char)str[i];
+        if (c >= '0' && c <= '9') {
+            d = (unsigned long)(c - '0');
+        } else if (base == 16 && isxdigit(c)) {
+            d = (unsigned long)(tolower(c) - 'a' + 10);
+        } else {
+            break;
+        }
+
+        if (r > (ULONG_MAX - d) / base) {
+            return 0;
+        }
+        r = r * base + d;
+    }
+
+    *v = r;
+    return i - start > 0? i: 0;
+}
+
+/**
+ * Multiplier for units following the value of a typed option, 0 if they're
+ * not valid for the option.
+ */
+static unsigned long cli__unit(unsigned type, const char *str, size_t n)
+{
+    if (n == 0) {
+        return (type == TYPE_DURATION)? 1000UL: 1UL;
+    }
+
+    if (type == TYPE_DURATION) {
+        if (n == 2 && str[0] == 'm' && str[1] == 's') {
+            return 1UL;
+        } else if (n == 1) {
+            switch (str[0]) {
+                case 's':
+                    return 1000UL;
+                case 'm':
+                    return 60000UL;
+                case 'h':
+                    return 3600000UL;
+                case 'd':
+                    return 86400000UL;
+            }
+        }
+    } else if (type == TYPE_SIZE && n == 1) {
+        switch (str[0]) {
+            case 'k': case 'K':
+                return 1024UL;
+            case 'm': case 'M':
+                return 1024UL * 1024UL;
+            case 'g': case 'G':
+                return 1024UL * 1024UL * 1024UL;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Report a bad value for a typed option.
+ */
+static void cli__bad_value(
+    const struct clip *clip,
+    const struct cli_opt *opt,
+    const char *pfx)
+{
+    FILE *out;
+    char chr;
+
+    out = (clip->out != NULL)? clip->out: stderr;
+    if (opt->a_long != NULL) {
+        cli_bad_arg(
+            out,
+            clip->flags,
+            2,
+            pfx,
+            opt->a_long,
+            strlen(opt->a_long)
+        );
+    } else {
+        chr = (char)opt->a_short;
+        cli_bad_arg(out, clip->flags, 1, pfx, &chr, 1);
+    }
+}
+
+/**
+ * Convert and check the value of a typed option, into `l` for integers and
+ * `u` for the others. Without a `struct cli_ext` to check it against, it's
+ * invalid.
+ */
+static int cli__value(
+    const struct clip *clip,
+    const struct cli_opt *opt,
+    const char *value,
+    size_t len,
+    long *l,
+    unsigned long *u)
+{
+    const struct cli_ext *ext;
+    unsigned long v, m;
+    unsigned type;
+    size_t n;
+    int neg;
+
+    if ((ext = opt->ext) == NULL) {
+        return CLIP_ERR_INVALID;
+    }
+
+    type = opt->mode & ARG_TYPE;
+    if (type == TYPE_FLAGS) {
+        *u = (unsigned long)ext->max;
+        return CLIP_ERR_OK;
+    }
+
+    neg = 0;
+    if (type == TYPE_INT &&
+        len > 0 &&
+        (value[0] == '-' || value[0] == '+')) {
+        neg = value[0] == '-';
+        value++;
+        len--;
+    }
+
+    if ((n = cli__ulong(value, len, &v)) == 0) {
+        cli__bad_value(clip, opt, "Invalid value for");
+        return CLIP_ERR_BAD_ARG;
+    }
+    value += n;
+    len   -= n;
+
+    /* Units, if any */
+    if ((m = cli__unit(type, value, len)) == 0) {
+        cli__bad_value(clip, opt, "Invalid value for");
+        return CLIP_ERR_BAD_ARG;
+    }
+    if (v > ULONG_MAX / m) {
+        cli__bad_value(clip, opt, "Value out of range for");
+        return CLIP_ERR_BAD_ARG;
+    }
+    v *= m;
+
+    if (type == TYPE_INT) {
+        if (v > (unsigned long)LONG_MAX + (unsigned long)neg) {
+            cli__bad_value(clip, opt, "Value out of range for");
+            return CLIP_ERR_BAD_ARG;
+        }
+        *l = (neg && v > 0)? -(long)(v - 1) - 1: (long)v;
+        if (ext->min < ext->max && (*l < ext->min || *l > ext->max)) {
+            cli__bad_value(clip, opt, "Value out of range for");
+            return CLIP_ERR_BAD_ARG;
+        }
+        return CLIP_ERR_OK;
+    }
+
+    if ((ext->min < ext->max &&
+         (v < (unsigned long)ext->min || v > (unsigned long)ext->max)) ||
+        (type == TYPE_SIZE && (size_t)v != v)) {
+        cli__bad_value(clip, opt, "Value out of range for");
+        return CLIP_ERR_BAD_ARG;
+    }
+    *u = v;
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Convert the value of a typed option and store it in `usr`, which mustn't be
+ * NULL.
+ */
+static int cli__store(
+    const struct clip *clip,
+    const struct cli_opt *opt,
+    const char *value,
+    size_t len,
+    void *usr)
+{
+    unsigned long u;
+    char *dst;
+    long l;
+    int r;
+
+    if (usr == NULL) {
+        return CLIP_ERR_INVALID;
+    }
+    if ((r = cli__value(clip, opt, value, len, &l, &u)) != CLIP_ERR_OK) {
+        return r;
+    }
+
+    dst = (char *)usr + opt->ext->off;
+    switch (opt->mode & ARG_TYPE) {
+        case TYPE_FLAGS:
+            *(unsigned *)dst |= (unsigned)u;
+            break;
+        case TYPE_INT:
+            *(long *)dst = l;
+            break;
+        case TYPE_SIZE:
+            *(size_t *)dst = (size_t)u;
+            break;
+        default:
+            *(unsigned long *)dst = u;
+            break;
+    }
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Find the first element that isn't empty of a list value of `len` bytes from
+ * `*at`, split at `sep`. Returns its length, or 0 if there's none, with `*at`
+ * moved past it.
+ */
+static size_t cli__elem(
+    int sep,
+    const char *value,
+    size_t len,
+    size_t *at,
+    const char **elem)
+{
+    const char *p;
+    size_t n;
+
+    while (*at < len) {
+        *elem = value + *at;
+        p     = (const char *)memchr(*elem, sep, len - *at);
+        n     = (p != NULL)? (size_t)(p - *elem): len - *at;
+        *at  += n + 1;
+        if (n > 0) {
+            return n;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Handler of the option of `tok`, its own or its sub-command's, or NULL for
+ * the clip's call-backs.
+ */
+static clap_cbn cli__handler(const struct cli_token *tok)
+{
+    if (OPT_CB(tok->opt) != NULL) {
+        return tok->opt->ext->cb;
+    }
+    return (tok->cmd != NULL)? tok->cmd->cb: NULL;
+}
+
+/**
+ * Invoke the call-back for a slice of positional arguments, see ::clap_cbs,
+ * or the others for each of them.
+ */
+static int cli__call_slice(
+    struct clip_state *st,
+    const struct cli_token *tok,
+    clap_cbn cb)
+{
+    const char *const *args;
+    size_t i;
+    int r;
+
+    args = &st->argv[tok->index];
+    if (cb == NULL && st->clip->cbs != NULL) {
+        r = st->clip->cbs(st, tok->cmd, tok->opt, args, tok->len);
+        return (r != 0)? CLIP_ERR_CB_FAIL: CLIP_ERR_OK;
+    }
+
+    for (i = 0, r = 0; i < tok->len && r == 0; i++) {
+        if (cb != NULL) {
+            r = cb(st, tok->cmd, tok->opt, args[i], strlen(args[i]));
+        } else if (st->clip->cbn != NULL) {
+            r = st->clip->cbn(st, tok->cmd, tok->opt, args[i], strlen(args[i]));
+        } else if (st->clip->cb != NULL) {
+            r = st->clip->cb(st->clip, tok->cmd, tok->opt, args[i]);
+        }
+    }
+    return (r != 0)? CLIP_ERR_CB_FAIL: CLIP_ERR_OK;
+}
+
+/**
+ * Invoke the call-back for each element of the value of a list option, see
+ * ::CLI_OPT_LIST(). Only `cb` of the clip is given a copy of each, made in
+ * the room left in `fbuf`, which it's needed only until the call returns.
+ */
+static int cli__call_list(
+    struct clip_state *st,
+    const struct cli_token *tok,
+    clap_cbn cb)
+{
+    const char *elem;
+    char *buf;
+    size_t at, n;
+    int sep, r;
+
+    if (cb == NULL) {
+        cb = st->clip->cbn;
+    }
+
+    at  = 0;
+    sep = OPT_SEP(tok->opt);
+    for (r = 0; r == 0; ) {
+        if ((n = cli__elem(sep, tok->value, tok->len, &at, &elem)) == 0) {
+            break;
+        }
+
+        if (cb != NULL) {
+            r = cb(st, tok->cmd, tok->opt, elem, n);
+        } else if (st->clip->cb != NULL) {
+            if (st->fbuf == NULL || st->f_top - st->f_used <= n) {
+                cli_bad_arg(
+                    (st->clip->out != NULL)? st->clip->out: stderr,
+                    st->clip->flags,
+                    0,
+                    "No room to copy value:",
+                    elem,
+                    n
+                );
+                return CLIP_ERR_BAD_ARG;
+            }
+            buf = &st->fbuf[st->f_top - n - 1];
+            memcpy(buf, elem, n);
+            buf[n] = 0;
+            r      = st->clip->cb(st->clip, tok->cmd, tok->opt, buf);
+        }
+    }
+    return (r != 0)? CLIP_ERR_CB_FAIL: CLIP_ERR_OK;
+}
+
+/**
+ * Invoke the call-back for an option. The option's or sub-command's handler
+ * is preferred, then `cbn` if it's set, else `value` must be NUL terminated.
+ */
+static int cli__call(struct clip_state *st, const struct cli_token *tok)
+{
+    const struct cli_opt *opt;
+    clap_cbn cb;
+    int r;
+
+    opt = tok->opt;
+    cb  = cli__handler(tok);
+    STAT_ADD(st, calls, 1);
+#ifdef CLIP_STATS
+    if (st->stats != NULL && st->stats->cb_begin != NULL) {
+        st->stats->cb_begin(st, tok);
+    }
+#endif
+
+    if ((opt->mode & ARG_TYPE) != 0) {
+        /* Typed options are stored straight away */
+        r = cli__store(st->clip, opt, tok->value, tok->len, st->usr);
+    } else if (tok->value == NULL && (opt->mode & ARG_ANYK) != 0) {
+        r = cli__call_slice(st, tok, cb);
+    } else if ((opt->mode & ARG_LIST) != 0 && tok->value != NULL) {
+        r = cli__call_list(st, tok, cb);
+    } else if (cb != NULL) {
+        r = cb(st, tok->cmd, opt, tok->value, tok->len);
+        r = (r != 0)? CLIP_ERR_CB_FAIL: CLIP_ERR_OK;
+    } else if (st->clip->cbn != NULL) {
+        r = st->clip->cbn(st, tok->cmd, opt, tok->value, tok->len);
+        r = (r != 0)? CLIP_ERR_CB_FAIL: CLIP_ERR_OK;
+    } else if (st->clip->cb != NULL) {
+        r = st->clip->cb(st->clip, tok->cmd, opt, tok->value);
+        r = (r != 0)? CLIP_ERR_CB_FAIL: CLIP_ERR_OK;
+    } else {
+        r = CLIP_ERR_OK;
+    }
+
+#ifdef CLIP_STATS
+    if (st->stats != NULL && st->stats->cb_end != NULL) {
+        st->stats->cb_end(st, tok, r);
+    }
+#endif
+    return r;
+}
+
+/**
+ * Carry on the FNV-1a hash `h` over `n` bytes of `str`.
+ */
+static unsigned long cli__fnv(unsigned long h, const char *str, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        h ^= (unsigned char)str[i];
+        h  = (h * 16777619UL) & 0xFFFFFFFFUL;
+    }
+
+    return h;
+}
+
+/**
+ * A simple FNV-1a hash of a file name. Sources are compared by hash since
+ * the name of a file included from a file read a line at a time doesn't last.
+ */
+static unsigned long cli__hash(const char *str, size_t n)
+{
+    return cli__fnv(2166136261UL, str, n);
+}
+
+/**
+ * Record a token of the arguments file being read, so that it can be replayed
+ * should the file be included again. Recording stops for the rest of parsing
+ * once there's no more room.
+ */
+static void cli__record(
+    struct clip_state *st,
+    const struct cli_sub_cmd *cmd,
+    const struct cli_opt *opt,
+    const char *value,
+    size_t len)
+{
+    struct cli_token *tok;
+
+    if (!st->f_rec) {
+        return;
+    }
+    /* Nor can it catch up with options of a split file not yet given out */
+    if (st->n_rec >= st->n_toks ||
+        (st->s_next != 0 && st->n_rec >= st->s_next)) {
+        st->f_rec = 0;
+        return;
+    }
+
+    tok = &st->toks[st->n_rec++];
+    tok->opt   = opt;
+    tok->cmd   = cmd;
+    tok->value = value;
+    tok->len   = len;
+    tok->index = st->index - 1;
+}
+
+/**
+ * Find an arguments file that's already been read during this parse.
+ */
+static struct cli_file *cli__file_find(
+    struct clip_state *st,
+    const char *name,
+    size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < st->f_n; i++) {
+        if (st->files[i].len == n &&
+            memcmp(st->files[i].name, name, n) == 0) {
+            return &st->files[i];
+        }
+    }
+
+    return NULL;
+}
+
+#ifdef CLIP_USE_MMAP
+/**
+ * Map arguments file named in `st->line`. Returns 1 if the file couldn't be
+ * mapped and should be read instead.
+ */
+static int cli__file_map(struct clip_state *st, struct cli_src *src)
+{
+    struct stat sb;
+    int fd;
+    char *map;
+    size_t n;
+
+    if ((fd = open(st->line, O_RDONLY)) < 0) {
+        return 1;
+    }
+    if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) || sb.st_size == 0) {
+        close(fd);
+        return 1;
+    }
+
+    /* A privately mapped file is writable without changing the file, that
+     * lets values be NUL terminated for `cb`.
+     */
+    n         = (size_t)sb.st_size;
+    src->term = st->clip->cbn == NULL;
+    map       = (char *)mmap(
+        NULL,
+        n,
+        src->term? (PROT_READ | PROT_WRITE): PROT_READ,
+        MAP_PRIVATE,
+        fd,
+        0
+    );
+    close(fd);
+    if (map == (char *)MAP_FAILED) {
+        return 1;
+    }
+
+    /* The rest of the last page is zero filled and can be written, only if
+     * the file ends right at a page boundary, the last line is copied out.
+     */
+    src->kind = SRC_BLOCK;
+    src->p    = map;
+    src->end  = map + n;
+    src->tail =
+        src->term &&
+        map[n - 1] != '\n' &&
+        n % (size_t)sysconf(_SC_PAGESIZE) == 0;
+    src->map     = map;
+    src->map_len = n;
+    STAT_ADD(st, file_bytes, n);
+
+    return 0;
+}
+#endif
+
+/**
+ * Open arguments file named in `st->line`. It's either read entirely into
+ * memory or, failing that, a line at a time.
+ */
+static int cli__file_open(struct clip_state *st, struct cli_src *src)
+{
+    FILE *f;
+    size_t len, room;
+    char *blk;
+
+#ifdef CLIP_USE_MMAP
+    if (cli__file_map(st, src) == 0) {
+        return CLIP_ERR_OK;
+    }
+#endif
+
+    if ((f = fopen(st->line, "r")) == NULL) {
+        fprintf(
+            (st->clip->out != NULL)? st->clip->out: stderr,
+            "Arguments file '%s' could not be opened.\n",
+            st->line
+        );
+        return CLIP_ERR_BAD_ARG;
+    }
+
+    /* Read the entire file in one go if it fits, a byte is left to NUL
+     * terminate the last line.
+     */
+    room = (st->fbuf != NULL)? st->f_top - st->f_used: 0;
+    if (room > 1) {
+        blk = &st->fbuf[st->f_used];
+        len = fread(blk, 1, room - 1, f);
+        if (len < room - 1 && !ferror(f)) {
+            fclose(f);
+            STAT_ADD(st, file_bytes, len);
+            st->f_used += len + 1;
+            src->kind = SRC_BLOCK;
+            src->term = 1;
+            src->p    = blk;
+            src->end  = blk + len;
+            return CLIP_ERR_OK;
+        }
+        rewind(f);
+    }
+
+    /* Lines don't last beyond the next, neither can anything recorded */
+    st->f_rec = 0;
+    src->kind   = SRC_LINES;
+    src->term   = 1;
+    src->f      = f;
+
+    return CLIP_ERR_OK;
+}
+
+#ifdef CLIP_USE_MMAP
+/**
+ * Start of an arguments file cached in `clip->cache_dir`. It's followed by a
+ * record of each option in the file, see cli__cache_put(). Caches are only
+ * ever read on the machine that wrote them, so it's all in the machine's own
+ * byte order.
+ */
+struct cli__cache {
+    char magic[8];
+    unsigned long tables;
+    unsigned long dev;
+    unsigned long ino;
+    unsigned long size;
+    unsigned long mtime;
+    unsigned long nsec;
+    unsigned long n_tok;
+    unsigned long bytes;
+};
+
+static const char cli__magic[8] = {
+    'C', 'L', 'I', 'P', 'c', '3', (char)sizeof(unsigned long), 0
+};
+
+static const char cli__zeros[sizeof(unsigned long)] = { 0 };
+
+/**
+ * Nanoseconds of the modification time in `sb`, if they're known.
+ */
+static unsigned long cli__cache_nsec(const struct stat *sb)
+{
+#if (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L) || \
+    (defined(_XOPEN_SOURCE) && _XOPEN_SOURCE >= 700)
+    return (unsigned long)sb->st_mtim.tv_nsec;
+#else
+    (void)sb;
+    return 0;
+#endif
+}
+
+/**
+ * Key that the cache of the file `sb` is named by, its device and inode, so
+ * that whatever name it's given by, it's the same file.
+ */
+static unsigned long cli__cache_key(const struct stat *sb)
+{
+    unsigned long id[2];
+
+    id[0] = (unsigned long)sb->st_dev;
+    id[1] = (unsigned long)sb->st_ino;
+    return cli__fnv(2166136261UL, (const char *)id, sizeof(id));
+}
+
+/**
+ * Hash of `str` and its end, told apart from NULL, into `h`.
+ */
+static unsigned long cli__cache_str(unsigned long h, const char *str)
+{
+    if (str == NULL) {
+        return cli__fnv(h, "\1", 1);
+    }
+    return cli__fnv(h, str, strlen(str) + 1);
+}
+
+/**
+ * Hash of what options in a file are found to be, which is the options of
+ * the live sub-command and of the base, in order, with everything that
+ * tells how they're given and stored.
+ */
+static unsigned long cli__cache_tables(const struct clip_state *st)
+{
+    static const struct cli_ext none = CLI_EXT(NULL, NULL);
+    const struct cli_sub_cmd *cmd;
+    const struct cli_ext *ext;
+    const struct cli_opt *opt;
+    unsigned long v[7];
+    char b;
+    unsigned long h;
+    int i;
+
+    b = (char)((st->clip->flags & CLIP_FLAG_PREFIX) != 0);
+    h = cli__fnv(2166136261UL, &b, 1);
+    for (i = 0; i < 2; i++) {
+        cmd = (i == 0)? st->live: st->clip->base;
+        if (cmd != NULL && cmd->opts != NULL && (i == 0 || cmd != st->live)) {
+            for (opt = cmd->opts; !IS_OPT_END(cmd, opt); opt++) {
+                ext  = (opt->ext != NULL)? opt->ext: &none;
+                v[0] = (unsigned long)opt->a_short;
+                v[1] = (unsigned long)opt->mode;
+                v[2] = (unsigned long)opt->attr;
+                v[3] = (unsigned long)ext->off;
+                v[4] = (unsigned long)ext->min;
+                v[5] = (unsigned long)ext->max;
+                v[6] = (unsigned long)(ext->cb != NULL);
+                h    = cli__fnv(h, (const char *)v, sizeof(v));
+                h    = cli__cache_str(h, opt->a_long);
+                h    = cli__cache_str(h, opt->tag);
+                h    = cli__cache_str(h, ext->env);
+            }
+        }
+        h = cli__fnv(h, "\n", 1);
+    }
+
+    /* Which sections of the file are given depends on the sub-commands */
+    for (i = 0; i < st->depth; i++) {
+        h = cli__fnv(h, st->trail[i]->name, strlen(st->trail[i]->name) + 1);
+    }
+
+    return h;
+}
+
+/**
+ * Name of the cache of the file read by `src`, or with `seq` the name it's
+ * written to first. That's made of the process id and the address of `src`,
+ * which no other parse in the process has while this one's running, and `seq`
+ * in case a process of the same id left one behind. Returns 0 if
+ * `clip->cache_dir` is too long.
+ */
+static int cli__cache_name(
+    const struct clip_state *st,
+    char *name,
+    const struct cli_src *src,
+    int seq)
+{
+    if (strlen(st->clip->cache_dir) >= CACHE_NAME - 64) {
+        return 0;
+    }
+
+    if (seq == 0) {
+        sprintf(name, "%s/%08lx.clc", st->clip->cache_dir, src->c_key);
+    } else {
+        sprintf(
+            name,
+            "%s/%08lx.%lu.%lx.%d.tmp",
+            st->clip->cache_dir,
+            src->c_key,
+            (unsigned long)getpid(),
+            (unsigned long)(size_t)src,
+            seq
+        );
+    }
+    return 1;
+}
+
+/**
+ * Number of options of `cmd`, `cmd` may be NULL.
+ */
+static unsigned long cli__cache_opts(const struct cli_sub_cmd *cmd)
+{
+    const struct cli_opt *opt;
+
+    if (cmd == NULL || cmd->opts == NULL) {
+        return 0;
+    }
+
+    for (opt = cmd->opts; !IS_OPT_END(cmd, opt); opt++) {
+        continue;
+    }
+    return (unsigned long)(opt - cmd->opts);
+}
+
+/**
+ * Check the `n_tok` records from `p` to `end` name options there are, and
+ * that values are NUL terminated within.
+ */
+static int cli__cache_check(
+    const struct clip_state *st,
+    const char *p,
+    const char *end,
+    unsigned long n_tok)
+{
+    const struct cli_sub_cmd *cmd;
+    unsigned long i, ref, len, n_live, n_base;
+
+    n_live = cli__cache_opts(st->live);
+    n_base = cli__cache_opts(st->clip->base);
+    for (i = 0; i < n_tok; i++) {
+        if ((size_t)(end - p) < 2 * sizeof(unsigned long)) {
+            return 0;
+        }
+        ref = ((const unsigned long *)p)[0];
+        len = ((const unsigned long *)p)[1];
+        p  += 2 * sizeof(unsigned long);
+
+        cmd = ((ref & CACHE_BASE) != 0)? st->clip->base: st->live;
+        ref = ref & ~CACHE_BASE;
+        if (ref >= ((cmd == st->live)? n_live: n_base) ||
+            (cmd->opts[ref].mode & ARG_ANYK) != 0) {
+            return 0;
+        }
+
+        if (len != CACHE_NONE) {
+            if (len >= (size_t)(end - p) || p[len] != 0) {
+                return 0;
+            }
+            p += CACHE_ALIGN(len + 1);
+        }
+    }
+
+    return p == end;
+}
+
+/**
+ * Map the cache of the arguments file `sb`. Returns 1 if there's none that's
+ * up to date, and the file should be read.
+ */
+static int cli__cache_map(
+    struct clip_state *st,
+    struct cli_src *src,
+    const struct stat *sb)
+{
+    char name[CACHE_NAME];
+    const struct cli__cache *hd;
+    struct stat cb;
+    char *map, *p;
+    size_t n;
+    int fd;
+
+    if (!cli__cache_name(st, name, src, 0) ||
+        (fd = open(name, O_RDONLY)) < 0) {
+        return 1;
+    }
+    if (fstat(fd, &cb) != 0 || !S_ISREG(cb.st_mode) ||
+        (size_t)cb.st_size < sizeof(struct cli__cache)) {
+        close(fd);
+        return 1;
+    }
+
+    n   = (size_t)cb.st_size;
+    map = (char *)mmap(NULL, n, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == (char *)MAP_FAILED) {
+        return 1;
+    }
+
+    /* Stale, or written by anything else, the file is read instead */
+    hd = (const struct cli__cache *)map;
+    p  = map + sizeof(struct cli__cache);
+    if (memcmp(hd->magic, cli__magic, sizeof(cli__magic)) != 0 ||
+        hd->dev != (unsigned long)sb->st_dev ||
+        hd->ino != (unsigned long)sb->st_ino ||
+        hd->size != (unsigned long)sb->st_size ||
+        hd->mtime != (unsigned long)sb->st_mtime ||
+        hd->nsec != cli__cache_nsec(sb) ||
+        hd->bytes != n - sizeof(struct cli__cache) ||
+        hd->tables != cli__cache_tables(st) ||
+        !cli__cache_check(st, p, map + n, hd->n_tok)) {
+        munmap(map, n);
+        return 1;
+    }
+
+    src->kind    = SRC_CACHE;
+    src->p       = p;
+    src->end     = map + n;
+    src->map     = map;
+    src->map_len = n;
+    STAT_ADD(st, file_bytes, n);
+
+    return 0;
+}
+
+/**
+ * Start writing the cache of the arguments file `sb`. It's written to a file
+ * of its own, and renamed over the cache once the file is read to the end,
+ * see cli__cache_end(). A file changed within the last second isn't cached,
+ * as it may yet change again with the same size and time.
+ */
+static void cli__cache_begin(
+    struct clip_state *st,
+    struct cli_src *src,
+    const struct stat *sb)
+{
+    char name[CACHE_NAME];
+    struct cli__cache hd;
+    FILE *f;
+    int fd, i;
+
+    if ((unsigned long)sb->st_mtime + 1 >= (unsigned long)time(NULL)) {
+        return;
+    }
+
+    /* A name left over by a process of the same id is passed over */
+    fd = -1;
+    for (i = 1; i <= 4 && fd < 0; i++) {
+        src->c_seq = i;
+        if (!cli__cache_name(st, name, src, src->c_seq)) {
+            return;
+        }
+        fd = open(name, O_WRONLY | O_CREAT | O_EXCL, 0600);
+        if (fd < 0 && errno != EEXIST) {
+            return;
+        }
+    }
+    if (fd < 0) {
+        return;
+    } else if ((f = fdopen(fd, "wb")) == NULL) {
+        close(fd);
+        remove(name);
+        return;
+    }
+
+    memcpy(hd.magic, cli__magic, sizeof(cli__magic));
+    hd.tables = cli__cache_tables(st);
+    hd.dev    = (unsigned long)sb->st_dev;
+    hd.ino    = (unsigned long)sb->st_ino;
+    hd.size   = (unsigned long)sb->st_size;
+    hd.mtime  = (unsigned long)sb->st_mtime;
+    hd.nsec   = cli__cache_nsec(sb);
+    hd.n_tok  = 0;
+    hd.bytes  = 0;
+
+    if (fwrite(&hd, sizeof(hd), 1, f) != 1) {
+        fclose(f);
+        remove(name);
+        return;
+    }
+
+    src->cache   = f;
+    src->c_n     = 0;
+    src->c_bytes = 0;
+}
+
+/**
+ * Finish writing the cache of an arguments file, only if it's `ok`, else it's
+ * thrown away.
+ */
+static void cli__cache_end(struct clip_state *st, struct cli_src *src, int ok)
+{
+    char name[CACHE_NAME], tmp[CACHE_NAME];
+    unsigned long counts[2];
+    FILE *f;
+
+    f = src->cache;
+    src->cache = NULL;
+
+    counts[0] = src->c_n;
+    counts[1] = src->c_bytes;
+    ok = ok &&
+        fseek(f, (long)offsetof(struct cli__cache, n_tok), SEEK_SET) == 0 &&
+        fwrite(counts, sizeof(counts), 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+
+    cli__cache_name(st, tmp, src, src->c_seq);
+    cli__cache_name(st, name, src, 0);
+    if (!ok || rename(tmp, name) != 0) {
+        remove(tmp);
+    }
+}
+
+/**
+ * Add option `tok`, just given out of the arguments file being cached, to its
+ * cache. A record is the index of the option in its sub-command, with
+ * ::CACHE_BASE set if that's the base, and the length of the value, if any,
+ * followed by the value itself, NUL terminated and padded.
+ */
+static void cli__cache_put(
+    struct clip_state *st,
+    struct cli_src *src,
+    const struct cli_token *tok)
+{
+    unsigned long rec[2];
+    size_t pad;
+
+    rec[0] = (unsigned long)(tok->opt - tok->cmd->opts);
+    if (tok->cmd != st->live) {
+        rec[0] |= CACHE_BASE;
+    }
+    rec[1] = (tok->value != NULL)? (unsigned long)tok->len: CACHE_NONE;
+
+    pad = CACHE_ALIGN(tok->len + 1) - tok->len;
+    if (fwrite(rec, sizeof(rec), 1, src->cache) != 1 ||
+        (tok->value != NULL &&
+         (fwrite(tok->value, 1, tok->len, src->cache) != tok->len ||
+          fwrite(cli__zeros, 1, pad, src->cache) != pad))) {
+        cli__cache_end(st, src, 0);
+        return;
+    }
+
+    src->c_n++;
+    src->c_bytes += sizeof(rec);
+    if (tok->value != NULL) {
+        src->c_bytes += (unsigned long)(tok->len + pad);
+    }
+}
+#endif
+
+/**
+ * Open arguments file named in `st->line`. With `clip->cache_dir`, its cache
+ * is used instead if it's up to date, else the file is cached as it's read.
+ */
+static int cli__file_load(struct clip_state *st, struct cli_src *src)
+{
+#ifdef CLIP_USE_MMAP
+    struct stat sb;
+    int r;
+
+    if (st->clip->cache_dir != NULL &&
+        stat(st->line, &sb) == 0 &&
+        S_ISREG(sb.st_mode)) {
+        src->c_key = cli__cache_key(&sb);
+        if (cli__cache_map(st, src, &sb) == 0) {
+            return CLIP_ERR_OK;
+        }
+        if ((r = cli__file_open(st, src)) == CLIP_ERR_OK) {
+            cli__cache_begin(st, src, &sb);
+        }
+        return r;
+    }
+#endif
+
+    return cli__file_open(st, src);
+}
+
+/**
+ * Whether section `[name]` of an arguments file, `n` bytes, names the
+ * sub-commands selected, as they're given on the command-line.
+ */
+static int cli__section(
+    const struct clip_state *st,
+    const char *name,
+    size_t n)
+{
+    const char *cmd;
+    size_t at, len;
+    int i;
+
+    at = 0;
+    for (i = 0; i < st->depth; i++) {
+        while (at < n && name[at] == ' ') {
+            at++;
+        }
+        cmd = st->trail[i]->name;
+        len = strlen(cmd);
+        if (len > n - at || memcmp(&name[at], cmd, len) != 0) {
+            return 0;
+        }
+        at += len;
+        if (at < n && name[at] != ' ') {
+            return 0;
+        }
+    }
+    while (at < n && name[at] == ' ') {
+        at++;
+    }
+
+    return st->depth > 0 && at == n;
+}
+
+/**
+ * Whether the section started by line `[...]`, `n` bytes with no line end,
+ * names the sub-commands selected. Returns -1 if it isn't a section at all.
+ */
+static int cli__section_line(
+    const struct clip_state *st,
+    const char *line,
+    size_t n)
+{
+    while (n > 0 && isspace((unsigned char)line[n - 1])) {
+        n--;
+    }
+    if (n < 2 || line[n - 1] != ']') {
+        return -1;
+    }
+
+    return cli__section(st, &line[1], n - 2);
+}
+
+/**
+ * A part of an arguments file whose options are looked up by cli__chunk_run().
+ */
+struct cli__chunk {
+    const struct clip_state *st;
+    char *p;
+    char *end;
+    int tail;
+    int skip;
+    struct cli_token *toks;
+    size_t cap;
+    size_t n;
+    int ok;
+};
+
+/**
+ * Look up the options of chunk `i` of `job`, maybe on a thread of its own, so
+ * nothing is written but its tokens. Lines that take more than finding an
+ * option are left with no `opt` for cli__file_next() to handle, as are any
+ * lines given with an option not found as such, so they're reported the same
+ * as when read on the calling thread. Lines in sections of other sub-commands
+ * are left the same, without looking them up.
+ */
+static void cli__chunk_run(void *job, int i)
+{
+    struct cli__chunk *ck;
+    const struct clip_state *st;
+    const struct cli_opt *opt;
+    const struct cli_sub_cmd *cmd;
+    struct cli_token *tok;
+    char *p, *nl, *eq;
+    size_t n, len;
+
+    ck = (struct cli__chunk *)job + i;
+    st = ck->st;
+    for (p = ck->p; p < ck->end; p = (nl != NULL)? nl + 1: ck->end) {
+        if (ck->n >= ck->cap) {
+            return;
+        }
+
+        nl  = (char *)memchr(p, '\n', (size_t)(ck->end - p));
+        n   = (size_t)(((nl != NULL)? nl: ck->end) - p);
+        tok = &ck->toks[ck->n++];
+        tok->opt   = NULL;
+        tok->cmd   = NULL;
+        tok->value = p;
+        tok->len   = n;
+        tok->index = st->index - 1;
+
+        if (nl == NULL && ck->tail) {
+            continue;
+        }
+        if (n > 0 && p[n - 1] == '\r') {
+            n--;
+        }
+        if (n > 0 && p[0] == '[') {
+            ck->skip = cli__section_line(st, p, n) == 0;
+            continue;
+        }
+        if (ck->skip || (n > 0 && (p[0] == '@' || p[0] == '#'))) {
+            continue;
+        }
+
+        eq = (char *)memchr(p, '=', n);
+        if (eq == NULL) {
+            eq = (char *)memchr(p, ' ', n);
+        }
+        len = (eq != NULL)? (size_t)(eq - p): n;
+        if (eq != NULL && len + 1 < n && (eq[1] == '"' || eq[1] == '\'')) {
+            continue;
+        }
+
+        cmd = st->live;
+        opt = cli__find_opt_0(cmd, st->l_idx, p, len, NULL);
+        if (opt == NULL && cmd != st->clip->base) {
+            cmd = st->clip->base;
+            opt = cli__find_opt_0(cmd, st->b_idx, p, len, NULL);
+        }
+        if (opt == NULL) {
+            continue;
+        }
+
+        tok->opt   = opt;
+        tok->cmd   = cmd;
+        tok->value = (eq != NULL)? eq + 1: NULL;
+        tok->len   = (eq != NULL)? n - len - 1: 0;
+    }
+
+    ck->ok = 1;
+}
+
+/**
+ * Whether the lines from `p` to `end` of the file `src` end in a section of
+ * other sub-commands, given whether they start in one, `skip`. Only the
+ * starts of sections are looked at, with memchr(), which is far quicker than
+ * looking up the options. Returns -1 at a line that isn't a section at all.
+ */
+static int cli__chunk_skip(
+    const struct clip_state *st,
+    const struct cli_src *src,
+    const char *p,
+    const char *end,
+    int skip)
+{
+    const char *nl;
+    int r;
+
+    for (; p < end; p++) {
+        if ((p = (const char *)memchr(p, '[', (size_t)(end - p))) == NULL) {
+            break;
+        }
+        if (p != src->p && p[-1] != '\n') {
+            continue;
+        }
+
+        nl = (const char *)memchr(p, '\n', (size_t)(src->end - p));
+        nl = (nl != NULL)? nl: src->end;
+        if ((r = cli__section_line(st, p, (size_t)(nl - p))) < 0) {
+            return -1;
+        }
+        skip = !r;
+    }
+
+    return skip;
+}
+
+/**
+ * Have the options of a large arguments file, just read into memory, looked
+ * up in chunks by `clip->par`. The room left in `st->toks` is shared out
+ * between chunks, and what they found is then moved to the top of it, leaving
+ * the rest to record the file in as it's given out. If that doesn't work out,
+ * the file is read as it would have been.
+ */
+static void cli__file_split(struct clip_state *st, struct cli_src *src)
+{
+    const struct clip *clip;
+    struct cli__chunk jobs[CLIP_PAR_MAX];
+    size_t size, room, n_tok;
+    char *p, *end, *nl;
+    int i, n, skip;
+
+    clip = st->clip;
+    size = (size_t)(src->end - src->p);
+    n    = (clip->par_n < CLIP_PAR_MAX)? clip->par_n: CLIP_PAR_MAX;
+    if (clip->par == NULL || n < 2 || st->toks == NULL ||
+        size < ((clip->par_min != 0)? clip->par_min: CLIP_PAR_MIN)) {
+        return;
+    }
+    for (i = 0; i < st->f_depth; i++) {
+        if (st->srcs[i].kind == SRC_CHUNKS) {
+            return;
+        }
+    }
+    room = (st->n_toks > st->n_rec)? st->n_toks - st->n_rec: 0;
+    if (room / (size_t)n == 0) {
+        return;
+    }
+
+    /* Chunks are about the same size, each up to the end of a line */
+    p    = src->p;
+    skip = src->skip;
+    for (i = 0; i < n; i++) {
+        end = src->end;
+        if (i < n - 1) {
+            end = src->p + size / (size_t)n * (size_t)(i + 1);
+            end = (end < p)? p: end;
+            nl  = (char *)memchr(end, '\n', (size_t)(src->end - end));
+            end = (nl != NULL)? nl + 1: src->end;
+        }
+
+        jobs[i].st   = st;
+        jobs[i].p    = p;
+        jobs[i].end  = end;
+        jobs[i].tail = src->tail && end == src->end;
+        jobs[i].skip = skip;
+        jobs[i].toks = &st->toks[st->n_rec + room / (size_t)n * (size_t)i];
+        jobs[i].cap  = room / (size_t)n;
+        jobs[i].n    = 0;
+        jobs[i].ok   = 0;
+
+        /* A bad section is left for reading the file as usual to report */
+        if ((skip = cli__chunk_skip(st, src, p, end, skip)) < 0) {
+            return;
+        }
+        p = end;
+    }
+
+    if (clip->par(clip, cli__chunk_run, jobs, n) != 0) {
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        if (!jobs[i].ok) {
+            return;
+        }
+    }
+
+    /* Chunks are moved up to follow one another, the last one first */
+    n_tok = st->n_toks;
+    for (i = n - 1; i >= 0; i--) {
+        n_tok -= jobs[i].n;
+        memmove(
+            &st->toks[n_tok],
+            jobs[i].toks,
+            jobs[i].n * sizeof(struct cli_token)
+        );
+    }
+
+    src->kind = SRC_CHUNKS;
+    src->next = n_tok;
+    src->last = st->n_toks;
+}
+
+/**
+ * Start reading arguments file `file` of `n` characters, which may be
+ * included from another arguments file. If `keep` is set, `file` remains in
+ * memory until parsing is over and the options of the file may be recorded to
+ * replay them when the same file is included again.
+ */
+static int cli__file_push(
+    struct clip_state *st,
+    const char *file,
+    size_t n,
+    int keep)
+{
+    FILE *out;
+    struct cli_file *ent;
+    struct cli_src *src;
+    unsigned long hash;
+    int i, r;
+
+    out = (st->clip->out != NULL)? st->clip->out: stderr;
+    if (st->srcs == NULL || st->n_srcs <= 0 || st->line == NULL) {
+        cli_bad_arg(out, st->clip->flags, 3, "No room to read file:", file, n);
+        return CLIP_ERR_BAD_ARG;
+    }
+    if (n >= st->line_len) {
+        cli_bad_arg(out, st->clip->flags, 3, "Invalid file:", file, n);
+        return CLIP_ERR_BAD_ARG;
+    }
+
+    /* The files being read are on the stack, another is a cycle */
+    if (st->f_depth >= st->n_srcs) {
+        cli_bad_arg(out, st->clip->flags, 3, "Too deeply nested:", file, n);
+        return CLIP_ERR_BAD_ARG;
+    }
+    hash = cli__hash(file, n);
+    for (i = 0; i < st->f_depth; i++) {
+        src = &st->srcs[i];
+        if (src->hash == hash &&
+            src->len == n &&
+            (src->name == NULL || memcmp(src->name, file, n) == 0)) {
+            cli_bad_arg(out, st->clip->flags, 3, "Recursive include:", file, n);
+            return CLIP_ERR_BAD_ARG;
+        }
+    }
+
+#ifdef CLIP_USE_MMAP
+    /* A cache would go stale with the file included, so it isn't made */
+    if (st->f_depth > 0 && st->srcs[st->f_depth - 1].cache != NULL) {
+        cli__cache_end(st, &st->srcs[st->f_depth - 1], 0);
+    }
+#endif
+
+    src = &st->srcs[st->f_depth];
+    src->name    = keep? file: NULL;
+    src->len     = n;
+    src->hash    = hash;
+    src->term    = 0;
+    src->tail    = 0;
+    src->skip    = 0;
+    src->f       = NULL;
+    src->ent     = NULL;
+    src->used    = st->f_used;
+#ifdef CLIP_USE_MMAP
+    src->map     = NULL;
+    src->map_len = 0;
+    src->cache   = NULL;
+#endif
+
+    ent = cli__file_find(st, file, n);
+    if (ent != NULL && ent->n_tok != CLIP_NO_TOKENS) {
+        /* Anything replayed is already recorded in the file that's replayed */
+        if (st->f_depth == 0 ||
+            st->srcs[st->f_depth - 1].kind != SRC_REPLAY) {
+            cli__record(st, NULL, NULL, file, n);
+        }
+        src->kind = SRC_REPLAY;
+        src->ent  = ent;
+        src->tok  = ent->tok;
+        st->f_depth++;
+        return CLIP_ERR_OK;
+    }
+
+    /* Only the files that remain in memory can be replayed later */
+    if (ent == NULL && keep && st->f_n < st->n_files) {
+        ent = &st->files[st->f_n++];
+        ent->name    = file;
+        ent->len     = n;
+        ent->tok     = 0;
+        ent->n_tok   = CLIP_NO_TOKENS;
+#ifdef CLIP_USE_MMAP
+        ent->map     = NULL;
+        ent->map_len = 0;
+#endif
+    } else {
+        ent = NULL;
+        st->f_rec = 0;
+    }
+
+    /* The name may well be in the line buffer already */
+    memmove(st->line, file, n);
+    st->line[n] = 0;
+
+    if ((r = cli__file_load(st, src)) != CLIP_ERR_OK) {
+        if (ent != NULL) {
+            st->f_n--;
+        }
+        return r;
+    }
+
+#ifdef CLIP_USE_MMAP
+    /* A file that's kept stays mapped until parsing is over */
+    if (ent != NULL && src->map != NULL) {
+        ent->map     = src->map;
+        ent->map_len = src->map_len;
+        src->map     = NULL;
+    }
+#endif
+
+    src->ent = ent;
+    src->tok = st->n_rec;
+    if (src->kind == SRC_BLOCK) {
+        cli__file_split(st, src);
+    }
+    st->f_depth++;
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Done reading the last arguments file. If it was read entirely, and is to be
+ * kept, its recorded tokens can now be replayed.
+ */
+static void cli__file_pop(struct clip_state *st, int ok)
+{
+    struct cli_src *src;
+
+    src = &st->srcs[--st->f_depth];
+    if (src->kind == SRC_REPLAY) {
+        return;
+    }
+
+    if (src->f != NULL) {
+        fclose(src->f);
+    }
+    if (src->kind == SRC_CHUNKS) {
+        st->s_next = 0;
+    }
+#ifdef CLIP_USE_MMAP
+    if (src->cache != NULL) {
+        cli__cache_end(st, src, ok);
+    }
+    if (src->map != NULL) {
+        munmap(src->map, src->map_len);
+    }
+#endif
+
+    if (src->ent == NULL) {
+        st->f_used = src->used;
+    } else if (ok && st->f_rec) {
+        src->ent->tok   = src->tok;
+        src->ent->n_tok = st->n_rec - src->tok;
+    }
+}
+
+/**
+ * Release all the arguments files read during this parse.
+ */
+static void cli__files_done(struct clip_state *st)
+{
+#ifdef CLIP_USE_MMAP
+    size_t i;
+#endif
+
+    while (st->f_depth > 0) {
+        cli__file_pop(st, 0);
+    }
+
+#ifdef CLIP_USE_MMAP
+    for (i = 0; i < st->f_n; i++) {
+        if (st->files[i].map != NULL) {
+            munmap(st->files[i].map, st->files[i].map_len);
+        }
+    }
+#endif
+
+    st->f_n     = 0;
+    st->f_used  = 0;
+    st->f_top   = st->fbuf_len - st->line_len;
+    st->n_rec   = 0;
+    st->f_rec   = 0;
+    st->s_next  = 0;
+}
+
+/**
+ * Unquote the word at `*p`, up to unquoted white space or `end`, in place the
+ * way a shell would: `'...'` is taken as is, `"..."` allows `\"` and `\\`,
+ * and outside quotes `\` escapes any character. Its length is stored at `n`
+ * and `*p` is moved past it. Returns 0 if a quote is left open, with the
+ * length of what was unquoted so far at `n`.
+ */
+static int cli__word(char **p, char *end, size_t *n)
+{
+    char *s, *d;
+    char q;
+
+    q = 0;
+    for (s = d = *p; s < end; s++) {
+        if (q == '\'') {
+            if (*s == '\'') {
+                q = 0;
+            } else {
+                *d++ = *s;
+            }
+        } else if (q == '"') {
+            if (*s == '"') {
+                q = 0;
+            } else if (*s == '\\' && s + 1 < end &&
+                       (s[1] == '"' || s[1] == '\\')) {
+                *d++ = *++s;
+            } else {
+                *d++ = *s;
+            }
+        } else if (*s == '\'' || *s == '"') {
+            q = *s;
+        } else if (*s == '\\' && s + 1 < end) {
+            *d++ = *++s;
+        } else if (isspace((unsigned char)*s)) {
+            break;
+        } else {
+            *d++ = *s;
+        }
+    }
+
+    *n = (size_t)(d - *p);
+    if (q != 0) {
+        return 0;
+    }
+
+    *p = s;
+    return 1;
+}
+
+/**
+ * Split `len` bytes of `buf` into words, packed back at the start of `buf`
+ * with a NUL after each, so `buf[len]` must be writable. The number of words
+ * is stored at `count`.
+ */
+static int cli__words(struct clip_state *st, char *buf, size_t len, int *count)
+{
+    char *p, *end, *dst, *word;
+    size_t n;
+    int c;
+
+    c   = 0;
+    p   = buf;
+    dst = buf;
+    end = buf + len;
+    for (;;) {
+        while (p < end && isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (p >= end) {
+            break;
+        }
+
+        word = p;
+        if (!cli__word(&p, end, &n)) {
+            cli_bad_arg(
+                (st->clip->out != NULL)? st->clip->out: stderr,
+                st->clip->flags,
+                0,
+                "Unterminated quote:",
+                word,
+                n
+            );
+            return CLIP_ERR_BAD_ARG;
+        }
+        if (c == INT_MAX) {
+            return CLIP_ERR_INVALID;
+        }
+
+        /* The white space after may well be where the NUL goes */
+        if (p < end) {
+            p++;
+        }
+        memmove(dst, word, n);
+        dst[n] = 0;
+        dst += n + 1;
+        c++;
+    }
+
+    *count = c;
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Handle a single line from arguments file, `line` need not be NUL
+ * terminated. If `term` is set, the value is NUL terminated in place, the
+ * line must then be followed by at least one writable byte. If `keep` is set,
+ * the line remains in memory until parsing is over. A value that starts with
+ * a quote is unquoted, see cli__word(). Returns NEXT_NONE if the line doesn't
+ * give an option.
+ */
+static int cli__file_line(
+    struct clip_state *st,
+    char *line,
+    size_t n,
+    int term,
+    int keep,
+    struct cli_token *out)
+{
+    char *eq, *val, *p;
+    size_t len, v_len;
+    const struct cli_opt *opt;
+    const struct cli_sub_cmd *cmd;
+    struct cli_src *src;
+    int r;
+
+    if (n > 0 && line[n - 1] == '\r') {
+        n--;
+    }
+
+    /* Blank lines and comments */
+    for (len = 0; len < n && isspace((unsigned char)line[len]); len++) {
+        ;
+    }
+    if (len == n || line[len] == '#') {
+        return NEXT_NONE;
+    }
+
+    /* Sections of other sub-commands are skipped, keys and all */
+    src = &st->srcs[st->f_depth - 1];
+    if (line[0] == '[') {
+        if ((r = cli__section_line(st, line, n)) < 0) {
+            while (isspace((unsigned char)line[n - 1])) {
+                n--;
+            }
+            cli_bad_arg(
+                (st->clip->out != NULL)? st->clip->out: stderr,
+                st->clip->flags,
+                0,
+                "Invalid section:",
+                line,
+                n
+            );
+            return CLIP_ERR_BAD_ARG;
+        }
+        src->skip = !r;
+        return NEXT_NONE;
+    }
+    if (src->skip) {
+        return NEXT_NONE;
+    }
+
+    /* Include another arguments file */
+    if (n > 1 && line[0] == '@') {
+        r = cli__file_push(st, &line[1], n - 1, keep);
+        return (r == CLIP_ERR_OK)? NEXT_NONE: r;
+    }
+
+    eq = (char *)memchr(line, '=', n);
+    if (eq == NULL) {
+        eq = (char *)memchr(line, ' ', n);
+    }
+
+    val   = NULL;
+    v_len = 0;
+    len   = n;
+    if (eq != NULL) {
+        len   = (size_t)(eq - line);
+        val   = eq + 1;
+        v_len = n - len - 1;
+
+        if (v_len > 0 && (val[0] == '"' || val[0] == '\'')) {
+            if (!term) {
+                /* Mapped read-only, unquote a copy instead */
+                if (v_len >= st->line_len) {
+                    cli_bad_arg(
+                        (st->clip->out != NULL)? st->clip->out: stderr,
+                        st->clip->flags,
+                        0,
+                        "Value too long:",
+                        val,
+                        v_len
+                    );
+                    return CLIP_ERR_BAD_ARG;
+                }
+                memcpy(st->line, val, v_len);
+                val       = st->line;
+                term      = 1;
+                keep      = 0;
+                st->f_rec = 0;
+            }
+
+            p = val;
+            if (!cli__word(&p, val + v_len, &len)) {
+                cli_bad_arg(
+                    (st->clip->out != NULL)? st->clip->out: stderr,
+                    st->clip->flags,
+                    0,
+                    "Unterminated quote:",
+                    val,
+                    len
+                );
+                return CLIP_ERR_BAD_ARG;
+            }
+            while (p < val + v_len && isspace((unsigned char)*p)) {
+                p++;
+            }
+            if (p < val + v_len) {
+                cli_bad_arg(
+                    (st->clip->out != NULL)? st->clip->out: stderr,
+                    st->clip->flags,
+                    0,
+                    "Unexpected text:",
+                    p,
+                    (size_t)(val + v_len - p)
+                );
+                return CLIP_ERR_BAD_ARG;
+            }
+
+            v_len = len;
+            len   = (size_t)(eq - line);
+        }
+
+        if (term) {
+            val[v_len] = 0;
+        }
+    }
+
+    opt = cli__match_opt(&cmd, st, line, len, len == 1? 1: 2);
+    if (opt == NULL) {
+        return CLIP_ERR_BAD_ARG;
+    }
+
+    cli__record(st, cmd, opt, val, v_len);
+
+    /* Unless kept, the line is gone once the next one is read */
+    st->v_tmp = !keep && val != NULL;
+
+    out->opt   = opt;
+    out->cmd   = cmd;
+    out->value = val;
+    out->len   = v_len;
+    out->index = st->index - 1;
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Get the next option from the arguments files being read, see
+ * cli__file_next().
+ */
+static int cli__file_get(struct clip_state *st, struct cli_token *out)
+{
+    struct cli_src *src;
+    const struct cli_token *tok;
+    char *line, *nl;
+    unsigned long ref, len;
+    size_t n;
+    int r, keep, last;
+
+    while (st->f_depth > 0) {
+        src  = &st->srcs[st->f_depth - 1];
+        keep = src->ent != NULL;
+
+        if (src->kind == SRC_REPLAY) {
+            if (src->tok >= src->ent->tok + src->ent->n_tok) {
+                cli__file_pop(st, 1);
+                continue;
+            }
+
+            tok = &st->toks[src->tok++];
+            if (tok->opt == NULL) {
+                /* An include that was itself replayed when recording */
+                r = cli__file_push(st, tok->value, tok->len, 0);
+                if (r != CLIP_ERR_OK) {
+                    return r;
+                }
+                continue;
+            }
+
+            *out = *tok;
+            return CLIP_ERR_OK;
+        } else if (src->kind == SRC_CACHE) {
+            if (src->p >= src->end) {
+                cli__file_pop(st, 1);
+                continue;
+            }
+
+            /* Records were all checked when the cache was mapped */
+            ref = ((const unsigned long *)src->p)[0];
+            len = ((const unsigned long *)src->p)[1];
+            src->p += 2 * sizeof(unsigned long);
+
+            out->cmd   = ((ref & CACHE_BASE) != 0)? st->clip->base: st->live;
+            out->opt   = &out->cmd->opts[ref & ~CACHE_BASE];
+            out->value = NULL;
+            out->len   = 0;
+            out->index = st->index - 1;
+            if (len != CACHE_NONE) {
+                out->value = src->p;
+                out->len   = (size_t)len;
+                src->p    += CACHE_ALIGN(len + 1);
+            }
+
+            cli__record(st, out->cmd, out->opt, out->value, out->len);
+            st->v_tmp = !keep && out->value != NULL;
+            return CLIP_ERR_OK;
+        } else if (src->kind == SRC_CHUNKS || src->kind == SRC_BLOCK) {
+            if (src->kind == SRC_CHUNKS) {
+                if (src->next >= src->last) {
+                    cli__file_pop(st, 1);
+                    continue;
+                }
+
+                *out = st->toks[src->next++];
+                st->s_next = src->next;
+                if (out->opt != NULL && src->skip) {
+                    continue;
+                } else if (out->opt != NULL) {
+                    /* What's left once the option's found, as for a block */
+                    if (src->term && out->value != NULL) {
+                        ((char *)out->value)[out->len] = 0;
+                    }
+                    cli__record(st, out->cmd, out->opt, out->value, out->len);
+                    st->v_tmp = !keep && out->value != NULL;
+                    return CLIP_ERR_OK;
+                }
+
+                line = (char *)out->value;
+                n    = out->len;
+                last = line + n == src->end;
+            } else {
+                if (src->p >= src->end) {
+                    cli__file_pop(st, 1);
+                    continue;
+                }
+
+                line   = src->p;
+                nl     = (char *)memchr(line, '\n', (size_t)(src->end - line));
+                n      = (size_t)(((nl != NULL)? nl: src->end) - line);
+                src->p = (nl != NULL)? nl + 1: src->end;
+                last   = nl == NULL;
+            }
+
+            /* No room to terminate the last line, so copy it out */
+            if (last && src->tail) {
+                if (n >= st->line_len) {
+                    cli_bad_arg(
+                        (st->clip->out != NULL)? st->clip->out: stderr,
+                        st->clip->flags,
+                        0,
+                        "Line too long:",
+                        line,
+                        n
+                    );
+                    return CLIP_ERR_BAD_ARG;
+                }
+                memcpy(st->line, line, n);
+                line = st->line;
+                keep = 0;
+                /* The copy doesn't last, neither can anything recorded */
+                st->f_rec = 0;
+            }
+        } else {
+            if (fgets(st->line, (int)st->line_len, src->f) == NULL) {
+                cli__file_pop(st, 1);
+                continue;
+            }
+
+            line = st->line;
+            keep = 0;
+#if defined(_WIN32) || \
+    defined(__WIN32__) || \
+    defined(__WINDOWS__) || \
+    defined(MSDOS) || \
+    defined(__DOS__) || \
+    defined(__MSDOS__) || \
+    defined(_MSDOS)
+            nl = strchr(line, '\r');
+            if (nl == NULL) {
+                nl = strchr(line, '\n');
+            }
+#else
+            nl = strchr(line, '\n');
+#endif
+            if (nl != NULL) {
+                *nl = 0;
+                n = (size_t)(nl - line);
+            } else {
+                n = strlen(line);
+                /* Don't silently split a line that doesn't fit */
+                if (n == st->line_len - 1 && !feof(src->f)) {
+                    cli_bad_arg(
+                        (st->clip->out != NULL)? st->clip->out: stderr,
+                        st->clip->flags,
+                        0,
+                        "Line too long:",
+                        line,
+                        n
+                    );
+                    return CLIP_ERR_BAD_ARG;
+                }
+            }
+            STAT_ADD(st, file_bytes, n + (nl != NULL));
+        }
+
+        r = cli__file_line(st, line, n, src->term, keep, out);
+        if (r != NEXT_NONE) {
+            return r;
+        }
+    }
+
+    return NEXT_NONE;
+}
+
+/**
+ * Get the next option from the arguments files being read. Returns NEXT_NONE
+ * once they're all done.
+ */
+static int cli__file_next(struct clip_state *st, struct cli_token *out)
+{
+    int r;
+
+    r = cli__file_get(st, out);
+#ifdef CLIP_USE_MMAP
+    /* Options are given out of the file read last */
+    if (r == CLIP_ERR_OK && st->srcs[st->f_depth - 1].cache != NULL) {
+        cli__cache_put(st, &st->srcs[st->f_depth - 1], out);
+    }
+#endif
+
+    return r;
+}
+
+
+/**
+ * Find the path through `cmds` to the sub-command `cmd`, no deeper than
+ * ::CLIP_CMD_DEPTH, storing it in `path` from `depth` on. Returns the depth
+ * of `cmd`, or 0 if it isn't among them.
+ */
+static int cli__cmd_path(
+    const struct cli_sub_cmd *cmds,
+    const struct cli_sub_cmd *cmd,
+    const struct cli_sub_cmd **path,
+    int depth)
+{
+    int n;
+
+    if (cmds == NULL || depth >= CLIP_CMD_DEPTH) {
+        return 0;
+    }
+
+    for (; !IS_CMD_END(cmds); cmds++) {
+        path[depth] = cmds;
+        if (cmds == cmd) {
+            return depth + 1;
+        }
+        if ((n = cli__cmd_path(cmds->cmds, cmd, path, depth + 1)) > 0) {
+            return n;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Print summary of a sub-command into `sk`, `st` is the parse it's printed
+ * for, if any.
+ */
+static void cli__summary(
+    struct cli__sink *sk,
+    const struct clip *clip,
+    const struct clip_state *st,
+    const struct cli_sub_cmd *cmd)
+{
+    const struct cli_opt *any;
+    const struct cli_sub_cmd *subs;
+    const struct cli_sub_cmd *path[CLIP_CMD_DEPTH];
+    const struct cli_sub_cmd *const *trail;
+    size_t width;
+    int depth;
+
+    if (cmd == NULL) {
+        cmd = clip->base;
+    }
+
+    /* The live sub-command was reached by the path parsed, others are found */
+    trail = path;
+    depth = 0;
+    if (st != NULL && cmd != NULL && cmd == st->live) {
+        trail = st->trail;
+        depth = st->depth;
+    } else if (cmd != NULL && cmd != clip->base) {
+        depth = cli__cmd_path(clip->cmds, cmd, path, 0);
+    }
+
+    width = cli__width(clip);
+
+    any = cli__find_any(cmd);
+    subs = (cmd == clip->base)? clip->cmds: cmd->cmds;
+
+    cli__put_s(sk, "Usage: ");
+    cli__puts(
+        sk,
+        (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_PROG: NULL,
+        NULL,
+        NULL,
+        clip->progname,
+        0
+    );
+
+    /* Name the full path to a nested sub-command */
+    if (depth > 0) {
+        int i;
+
+        for (i = 0; i < depth; i++) {
+            cli__puts(
+                sk,
+                (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_OPT: NULL,
+                " ",
+                NULL,
+                trail[i]->name,
+                0
+            );
+        }
+    } else if (cmd != NULL && cmd->name != NULL) {
+        cli__puts(
+            sk,
+            (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_OPT: NULL,
+            " ",
+            NULL,
+            cmd->name,
+            0
+        );
+    }
+
+    if (subs != NULL) {
+        cli__puts(
+            sk,
+            (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_CMD: NULL,
+            NULL,
+            NULL,
+            " [COMMAND]",
+            0
+        );
+    }
+    if (cmd != NULL && cmd->opts != NULL) {
+        cli__puts(
+            sk,
+            (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_OPT: NULL,
+            NULL,
+            NULL,
+            " [OPTIONS]",
+            0);
+    }
+    if (any != NULL) {
+        cli__puts(
+            sk,
+            (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_ANY: NULL,
+            " ",
+            "...",
+            any->tag,
+            0);
+    }
+    cli__put_c(sk, '\n');
+
+    if (clip->header != NULL) {
+        cli__puts(sk, NULL, NULL, "\n", clip->header, 0);
+    }
+
+    /* If there are sub-commands at this level, show them too */
+    if (subs != NULL) {
+        const struct cli_sub_cmd *sub;
+
+        cli__put_s(sk, "\nSub-commands:\n");
+        for (sub = subs; !IS_CMD_END(sub); sub++) {
+            cli__puts(
+                sk,
+                (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_CMD: NULL,
+                "\t",
+                "\n",
+                sub->name,
+                0
+            );
+        }
+    }
+
+    if (FLAGS_HAS_AUTO(clip->flags)) {
+        cli__puts(
+            sk,
+            (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_SUBTITLE: NULL,
+            "\n",
+            "\n",
+            "Default Options:",
+            0
+        );
+        if ((clip->flags & CLIP_FLAG_HELP) != 0) {
+            if (subs != NULL) {
+                cli__put_opt(
+                    sk,
+                    clip->flags & CLIP_FLAG_USE_ANSI,
+                    width,
+                    &def_help_cmds
+                );
+            } else {
+                cli__put_opt(
+                    sk,
+                    clip->flags & CLIP_FLAG_USE_ANSI,
+                    width,
+                    &def_help_base
+                );
+            }
+        }
+
+        if ((clip->flags & CLIP_FLAG_VERSION) != 0) {
+            const struct cli_opt *ver;
+
+            /* Only --version if -v is taken */
+            ver = cli__find_opt_0(
+                clip->base,
+                cli__index_of(clip, clip->base),
+                "v",
+                1,
+                NULL
+            );
+
+            cli__put_opt(
+                sk,
+                clip->flags & CLIP_FLAG_USE_ANSI,
+                width,
+                (ver != NULL)? &def_version_long: &def_version
+            );
+        }
+    }
+
+    if (cmd != NULL && cmd->opts != NULL) {
+        const struct cli_opt *opt;
+
+        cli__puts(
+            sk,
+            (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_SUBTITLE: NULL,
+            "\n",
+            "\n",
+            (cmd == clip->base)? "Common options:": "Options:",
+            0
+        );
+        for (opt = cmd->opts; !IS_OPT_END(cmd, opt); opt++) {
+            if (opt->help == NULL) {
+                continue;
+            }
+            cli__put_opt(sk, clip->flags & CLIP_FLAG_USE_ANSI, width, opt);
+        }
+    }
+
+    if (clip->footer != NULL) {
+        cli__puts(sk, NULL, "\n", "\n", clip->footer, 0);
+    }
+}
+
+/**
+ * Print summary of a sub-command to `clip->out`, see cli__summary(). During a
+ * parse, it's rendered into what's free of `fbuf`, else in pieces of
+ * ::CLIP_SUMMARY_BUFFER.
+ */
+static void cli__summary_out(
+    const struct clip *clip,
+    const struct clip_state *st,
+    const struct cli_sub_cmd *cmd)
+{
+    struct cli__sink sk;
+#if CLIP_SUMMARY_BUFFER > 0
+    char buf[CLIP_SUMMARY_BUFFER];
+
+    sk.buf  = buf;
+    sk.size = sizeof(buf);
+#else
+    sk.buf  = NULL;
+    sk.size = 0;
+#endif
+    sk.out  = (clip->out)? clip->out: stdout;
+    sk.used = 0;
+    sk.len  = 0;
+    cli__sink_fbuf(&sk, st);
+
+    cli__summary(&sk, clip, st, cmd);
+    if (sk.used > 0) {
+        fwrite(sk.buf, 1, sk.used, sk.out);
+    }
+}
+
+int cli_summary(const struct clip *clip, const struct cli_sub_cmd *cmd)
+{
+    if (clip == NULL) {
+        return CLIP_ERR_INVALID;
+    }
+
+    cli__summary_out(clip, NULL, cmd);
+    return 0;
+}
+
+int cli_summary_buf(
+    const struct clip *clip,
+    const struct cli_sub_cmd *cmd,
+    char *buf,
+    size_t size,
+    size_t *len)
+{
+    struct cli__sink sk;
+
+    if (clip == NULL || (buf == NULL && size != 0)) {
+        return CLIP_ERR_INVALID;
+    }
+
+    /* Room is left for the NUL */
+    sk.out  = NULL;
+    sk.buf  = buf;
+    sk.size = (size > 0)? size - 1: 0;
+    sk.used = 0;
+    sk.len  = 0;
+
+    cli__summary(&sk, clip, NULL, cmd);
+    if (size > 0) {
+        buf[sk.used] = 0;
+    }
+    if (len != NULL) {
+        *len = sk.len;
+    }
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Find out which of the automatic options are not shadowed by the default
+ * options. This doesn't change while parsing, so it's worked out only once.
+ */
+static unsigned cli__auto_opts(const struct clip_state *st)
+{
+    const struct clip *clip;
+    const struct cli_index *idx;
+    unsigned autos;
+
+    clip  = st->clip;
+    idx   = st->b_idx;
+    autos = 0;
+    if ((clip->flags & CLIP_FLAG_HELP) != 0) {
+        if (cli__find_opt_0(clip->base, idx, "h", 1, st) == NULL) {
+            autos |= AUTO_H;
+        }
+        if (cli__find_opt_0(clip->base, idx, "help", 4, st) == NULL) {
+            autos |= AUTO_HELP;
+        }
+    }
+
+    if ((clip->flags & CLIP_FLAG_VERSION) != 0 && clip->version != NULL) {
+        if (cli__find_opt_0(clip->base, idx, "v", 1, st) == NULL) {
+            autos |= AUTO_V;
+        }
+        if (cli__find_opt_0(clip->base, idx, "version", 7, st) == NULL) {
+            autos |= AUTO_VERSION;
+        }
+    }
+
+    return autos;
+}
+
+/**
+ * Check if an argument asks for automatic help or version. Returns one of
+ * the `AUTO_*` bits or 0.
+ */
+static unsigned cli__auto_match(unsigned autos, const char *arg)
+{
+    if (autos == 0 || arg[0] != '-') {
+        return 0;
+    }
+
+    switch (arg[1]) {
+        case 'h':
+            return autos & AUTO_H;
+        case 'v':
+            return autos & AUTO_V;
+        case '-':
+            if (strcmp(&arg[2], "help") == 0) {
+                return autos & AUTO_HELP;
+            } else if (strcmp(&arg[2], "version") == 0) {
+                return autos & AUTO_VERSION;
+            }
+            break;
+    }
+
+    return 0;
+}
+
+static int cli__auto_show(struct clip_state *st, unsigned which)
+{
+    FILE *out;
+
+    if ((which & (AUTO_H | AUTO_HELP)) != 0) {
+        cli__summary_out(st->clip, st, st->live);
+        return CLIP_ERR_HELP;
+    }
+
+    out = (st->clip->out != NULL)? st->clip->out: stderr;
+    if ((st->clip->flags & CLIP_FLAG_USE_ANSI) != 0) {
+        fprintf(
+            out,
+            ANSI_PROG "%s" ANSI_END " %s\n",
+            st->clip->progname,
+            st->clip->version
+        );
+    } else {
+        fprintf(out, "%s %s\n", st->clip->progname, st->clip->version);
+    }
+
+    return CLIP_ERR_HELP;
+}
+
+/**
+ * The argument at `st->index`, which must be less than `st->argc`.
+ */
+static const char *cli__peek(const struct clip_state *st)
+{
+    return (st->argv != NULL)? st->argv[st->index]: st->w_next;
+}
+
+/**
+ * Take the argument at `st->index` and move on to the next.
+ */
+static const char *cli__take(struct clip_state *st)
+{
+    const char *arg;
+
+    arg = cli__peek(st);
+    if (st->argv == NULL) {
+        st->w_next += strlen(arg) + 1;
+    }
+    st->index++;
+
+    return arg;
+}
+
+/**
+ * Descend into the sub-command named `arg`, if it is one at the depth parsing
+ * has got to. Returns 0 when it isn't, after which none are looked for.
+ */
+static int cli__sub_cmd(struct clip_state *st, const char *arg)
+{
+    const struct cli_sub_cmd *cmd;
+    const struct cli_cmd_key *key;
+
+    if (st->c_cmds == NULL ||
+        st->depth >= CLIP_CMD_DEPTH ||
+        !isalnum((unsigned char)arg[0])) {
+        st->c_cmds = NULL;
+        return 0;
+    }
+
+    /* 2 things can happen here:
+     *  ->    This is a sub-command, so match for it.
+     *  ->(*) Otherwise, if the live command has NARGS, then feed this to
+     *        it.
+     *
+     * We do the first one here, but let it roll into cli_next() for
+     * NARGS matching.
+     */
+    STAT_ADD(st, strlens, 1);
+    cmd = cli__find_cmd(st->c_cmds, st->c_keys, st->c_n, &key, arg,
+                        strlen(arg), st);
+    if (cmd == NULL) {
+        st->c_cmds = NULL;
+        return 0;
+    }
+
+    st->live  = cmd;
+    st->l_idx = cli__index_of(st->clip, cmd);
+    st->trail[st->depth++] = cmd;
+
+    /* Nested sub-commands, if any, are next */
+    st->c_cmds = cmd->cmds;
+    if (key != NULL) {
+        st->c_keys = &st->clip->cmd_idx->keys[key->sub];
+        st->c_n    = key->n_sub;
+    }
+
+    return 1;
+}
+
+/**
+ * Print the name of `opt` to `out`, the long one if it has one.
+ */
+static void cli__opt_name(FILE *out, unsigned flags, const struct cli_opt *opt)
+{
+    if ((flags & CLIP_FLAG_USE_ANSI) != 0) {
+        fprintf(out, ANSI_ERR);
+    }
+    if (opt->a_long != NULL) {
+        fprintf(out, "--%s", opt->a_long);
+    } else {
+        fprintf(out, "-%c", opt->a_short);
+    }
+    if ((flags & CLIP_FLAG_USE_ANSI) != 0) {
+        fprintf(out, ANSI_END);
+    }
+}
+
+/**
+ * Print the message `pfx` for option `opt`, and `other` if it's not NULL.
+ */
+static void cli__bad_opt(
+    const struct clip_state *st,
+    const char *pfx,
+    const struct cli_opt *opt,
+    const struct cli_opt *other)
+{
+    FILE *out;
+
+    out = (st->clip->out != NULL)? st->clip->out: stderr;
+    fprintf(out, "%s ", pfx);
+    cli__opt_name(out, st->clip->flags, opt);
+    if (other != NULL) {
+        fprintf(out, " and ");
+        cli__opt_name(out, st->clip->flags, other);
+    }
+    fputc('\n', out);
+}
+
+/**
+ * Bitset in `st->marks` of `which` options of `cmd` are, MARK_SEEN or
+ * MARK_GIVEN. It holds `st->m_bytes` bytes.
+ */
+static unsigned char *cli__marks(
+    const struct clip_state *st,
+    const struct cli_sub_cmd *cmd,
+    int which)
+{
+    return &st->marks[st->m_bytes * (2 * which + (cmd != st->clip->base))];
+}
+
+/**
+ * Whether option `i` of `cmd` is marked as `which`, see cli__marks().
+ */
+static int cli__marked(
+    const struct clip_state *st,
+    const struct cli_sub_cmd *cmd,
+    int which,
+    size_t i)
+{
+    return (cli__marks(st, cmd, which)[i / ATTR_BITS]
+        & (1U << (i % ATTR_BITS))) != 0;
+}
+
+/**
+ * Option of `group` other than `opt` that was seen, of the base or the live
+ * sub-command. That's only looked for to say which it was.
+ */
+static const struct cli_opt *cli__group_opt(
+    const struct clip_state *st,
+    unsigned group,
+    const struct cli_opt *opt)
+{
+    const struct cli_sub_cmd *cmd;
+    const struct cli_opt *o;
+    size_t i;
+    int k;
+
+    for (k = 0; k < 2; k++) {
+        cmd = (k == 0)? st->clip->base: st->live;
+        if (cmd == NULL ||
+            cmd->opts == NULL ||
+            (k == 1 && cmd == st->clip->base)) {
+            continue;
+        }
+        for (o = cmd->opts, i = 0; !IS_OPT_END(cmd, o); o++, i++) {
+            if (i >= st->m_bytes * ATTR_BITS) {
+                break;
+            }
+            if (o != opt &&
+                ATTR_GROUP(o) == group &&
+                cli__marked(st, cmd, MARK_SEEN, i)) {
+                return o;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Mark option of `tok` as seen, returns CLIP_ERR_BAD_ARG if it was already and
+ * may be given once, or another of its group was, or it has attributes and
+ * there's no room to mark it. Options without attributes are marked too, so
+ * that the environment doesn't give them again.
+ */
+static int cli__attr_seen(struct clip_state *st, const struct cli_token *tok)
+{
+    const struct cli_opt *opt;
+    unsigned char *seen;
+    unsigned bit;
+    size_t i;
+    unsigned group;
+
+    opt = tok->opt;
+    if (opt == NULL) {
+        return CLIP_ERR_OK;
+    }
+
+    i = (size_t)(opt - tok->cmd->opts);
+    if (i >= st->m_bytes * ATTR_BITS) {
+        if (opt->attr == 0) {
+            return CLIP_ERR_OK;
+        }
+        cli__bad_opt(st, "No room to mark option:", opt, NULL);
+        return CLIP_ERR_BAD_ARG;
+    }
+
+    seen = cli__marks(st, tok->cmd, MARK_SEEN);
+    bit  = 1U << (i % ATTR_BITS);
+    if ((seen[i / ATTR_BITS] & bit) != 0) {
+        if ((opt->attr & CLI_ATTR_ONCE) != 0) {
+            cli__bad_opt(st, "Option given more than once:", opt, NULL);
+            return CLIP_ERR_BAD_ARG;
+        }
+        return CLIP_ERR_OK;
+    }
+    seen[i / ATTR_BITS] |= (unsigned char)bit;
+
+    /* Seen for the first time, any other of its group is another option */
+    group = ATTR_GROUP(opt);
+    if (group != 0 && group < CLIP_GROUP_MAX) {
+        if ((st->g_seen & (1UL << group)) != 0) {
+            cli__bad_opt(
+                st,
+                "Options can't be used together:",
+                cli__group_opt(st, group, opt),
+                opt
+            );
+            return CLIP_ERR_BAD_ARG;
+        }
+        st->g_seen |= 1UL << group;
+    }
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Check that all the required options of `cmd` were seen.
+ */
+static int cli__attr_cmd(
+    const struct clip_state *st,
+    const struct cli_sub_cmd *cmd)
+{
+    const struct cli_opt *opt;
+    size_t i;
+
+    if (cmd == NULL || cmd->opts == NULL) {
+        return CLIP_ERR_OK;
+    }
+
+    for (opt = cmd->opts, i = 0; !IS_OPT_END(cmd, opt); opt++, i++) {
+        if ((opt->attr & CLI_ATTR_REQUIRED) == 0) {
+            continue;
+        }
+        if (i >= st->m_bytes * ATTR_BITS) {
+            cli__bad_opt(st, "No room to mark option:", opt, NULL);
+            return CLIP_ERR_BAD_ARG;
+        }
+        if (!cli__marked(st, cmd, MARK_SEEN, i)) {
+            cli__bad_opt(st, "Missing required option:", opt, NULL);
+            return CLIP_ERR_BAD_ARG;
+        }
+    }
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Check required options of the base and live sub-command, once all that's
+ * given has been parsed.
+ */
+static int cli__attr_end(const struct clip_state *st)
+{
+    int r;
+
+    r = cli__attr_cmd(st, st->clip->base);
+    if (r == CLIP_ERR_OK && st->live != st->clip->base) {
+        r = cli__attr_cmd(st, st->live);
+    }
+    return r;
+}
+
+/**
+ * Option of `cmd` that is named `name` in the environment, searched for in the
+ * options that name their variable, by index if there is one.
+ */
+static const struct cli_opt *cli__env_opt(
+    const struct cli_sub_cmd *cmd,
+    const struct cli_index *idx,
+    const struct clip_state *st,
+    const char *name,
+    size_t n)
+{
+    const struct cli_opt *opt;
+
+    if (cmd == NULL) {
+        return NULL;
+    } else if (idx != NULL) {
+        return cli__key_find(idx->envs, idx->n_envs, name, n, st);
+    }
+
+    for (opt = cmd->opts; opt != NULL && !IS_OPT_END(cmd, opt); opt++) {
+        if (OPT_ENV(opt) == NULL) {
+            continue;
+        }
+        STAT_ADD(st, compares, 1);
+        if (strncmp(opt->ext->env, name, n) == 0 && opt->ext->env[n] == 0) {
+            return opt;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Option of the live sub-command, or else the base, that is named `name` in
+ * the environment, see cli__env_opt().
+ */
+static const struct cli_opt *cli__env_named(
+    const struct cli_sub_cmd **whence,
+    const struct clip_state *st,
+    const char *name,
+    size_t n)
+{
+    const struct cli_opt *opt;
+
+    *whence = st->live;
+    opt = cli__env_opt(st->live, st->l_idx, st, name, n);
+    if (opt == NULL && st->live != st->clip->base) {
+        *whence = st->clip->base;
+        opt = cli__env_opt(st->clip->base, st->b_idx, st, name, n);
+    }
+
+    return opt;
+}
+
+/**
+ * Whether an option taken from the environment is given by the arguments
+ * already, or another of its group is, so that it's dropped.
+ */
+static int cli__env_given(
+    const struct clip_state *st,
+    const struct cli_sub_cmd *cmd,
+    const struct cli_opt *opt,
+    size_t i)
+{
+    unsigned group;
+
+    if (cli__marked(st, cmd, MARK_SEEN, i)) {
+        return 1;
+    }
+
+    group = ATTR_GROUP(opt);
+    return group != 0 &&
+        group < CLIP_GROUP_MAX &&
+        (st->g_seen & (1UL << group)) != 0;
+}
+
+/**
+ * Get the next option that's given in the environment, returns NEXT_NONE when
+ * there are no more in this pass.
+ *
+ * Names after the prefix are turned into long options and found as any other,
+ * by index if there is one. Only those that don't match go through options
+ * that name a variable of their own.
+ *
+ * The environment is gone through once, after the arguments, and an option is
+ * given only if neither they nor an arguments file gave it. Options past what
+ * `st->marks` has room for can't be told as given, so they fail the parse.
+ */
+static int cli__env_next(struct clip_state *st, struct cli_token *tok)
+{
+    const struct cli_sub_cmd *cmd;
+    const struct cli_opt *opt;
+    const char *var, *name, *value;
+    char key[ENV_NAME];
+    size_t p_len, n, i;
+
+    p_len = strlen(st->clip->env_prefix);
+    while ((var = *st->e_pos) != NULL) {
+        st->e_pos++;
+        if (strncmp(var, st->clip->env_prefix, p_len) != 0) {
+            continue;
+        }
+
+        name = var + p_len;
+        if ((value = strchr(name, '=')) == NULL) {
+            continue;
+        }
+        n = (size_t)(value - name);
+        value++;
+        if (n < 2 || n >= sizeof(key)) {
+            continue;
+        }
+
+        for (i = 0; i < n; i++) {
+            key[i] = (name[i] == '_')? '-': (char)tolower((unsigned char)name[i]);
+        }
+        opt = cli__find_opt(&cmd, st, key, n);
+        if (opt == NULL || OPT_ENV(opt) != NULL) {
+            opt = cli__env_named(&cmd, st, name, n);
+        }
+        if (opt == NULL) {
+            continue;
+        }
+
+        if (IS_SWITCH(opt)) {
+            if (value[0] == 0 || strcmp(value, "0") == 0) {
+                continue;
+            }
+            value = NULL;
+        }
+
+        i = (size_t)(opt - cmd->opts);
+        if (i >= st->m_bytes * ATTR_BITS) {
+            cli__bad_opt(st, "No room to mark option:", opt, NULL);
+            st->e_pos = NULL;
+            return CLIP_ERR_BAD_ARG;
+        }
+        if (cli__env_given(st, cmd, opt, i)) {
+            continue;
+        }
+
+        tok->opt   = opt;
+        tok->cmd   = cmd;
+        tok->value = value;
+        tok->len   = (value != NULL)? strlen(value): 0;
+        tok->index = 0;
+        return CLIP_ERR_OK;
+    }
+
+    st->e_pos = NULL;
+    return NEXT_NONE;
+}
+
+/**
+ * Reset all state of `st` for a new parse, see cli__begin().
+ */
+static void cli__reset(
+    struct clip_state *st,
+    int argc,
+    const char *const *argv,
+    const char *words)
+{
+    st->index   = 0;
+    st->argc    = argc;
+    st->argv    = argv;
+    st->w_next  = words;
+    st->arg     = NULL;
+    st->a_pos   = 0;
+    st->a_index = 0;
+    st->c_next  = 0;
+    st->done    = 0;
+
+    /* We start at the base defaults */
+    st->live  = st->clip->base;
+    st->b_idx = cli__index_of(st->clip, st->clip->base);
+    st->l_idx = st->b_idx;
+    st->depth = 0;
+    st->autos = cli__auto_opts(st);
+
+    /* Lines are read into the top of fbuf, whole files below them */
+    st->line_len = (st->fbuf == NULL)? 0:
+        (st->fbuf_len < CLIP_BUFFER_SIZE)? st->fbuf_len: CLIP_BUFFER_SIZE;
+    st->line     = (st->line_len > 0)?
+        &st->fbuf[st->fbuf_len - st->line_len]: NULL;
+
+    /* Arguments files are recorded if there's somewhere to */
+    st->f_n     = 0;
+    st->f_depth = 0;
+    st->f_used  = 0;
+    st->f_top   = st->fbuf_len - st->line_len;
+    st->n_rec   = 0;
+    st->f_rec   = st->toks != NULL && st->n_toks > 0;
+    st->s_next  = 0;
+
+    /* Sub-commands are looked for from the top */
+    st->c_cmds = st->clip->cmds;
+    st->c_keys = NULL;
+    st->c_n    = 0;
+    if (st->clip->cmd_idx != NULL && st->clip->cmd_idx->cmds == st->c_cmds) {
+        st->c_keys = st->clip->cmd_idx->keys;
+        st->c_n    = st->clip->cmd_idx->n_top;
+    }
+
+    st->feed   = 0;
+    st->dashed = 0;
+    st->p_opt  = NULL;
+    st->p_cmd  = NULL;
+
+    /* The result is laid out once sub-commands are matched */
+    if (st->result != NULL) {
+        st->result->cmd   = NULL;
+        st->result->base  = NULL;
+        st->result->n_all = 0;
+    }
+
+    /* Nothing's been seen of options, marks are split in four */
+    st->m_bytes = (st->marks != NULL)? st->n_marks / 4: 0;
+    if (st->m_bytes > 0) {
+        memset(st->marks, 0, 4 * st->m_bytes);
+    }
+    st->g_seen = 0;
+    st->e_pos  = NULL;
+    st->h_n    = 0;
+
+    /* The NARGS option is found once for each sub-command parsed in */
+    st->any     = NULL;
+    st->any_cmd = NULL;
+}
+
+/**
+ * Print the sub-commands that can be given next, that `str` is a prefix of,
+ * a line each.
+ */
+static void cli__complete_cmds(
+    struct cli__sink *sk,
+    const struct clip_state *st,
+    const char *str,
+    size_t s_len)
+{
+    const struct cli_sub_cmd *cmd;
+    const struct cli_cmd_key *key;
+    size_t lo, hi, mid;
+
+    if (st->c_cmds == NULL || st->depth >= CLIP_CMD_DEPTH) {
+        return;
+    }
+
+    if (st->c_keys != NULL) {
+        /* Names starting with `str` are all together, as for options */
+        lo = 0;
+        hi = st->c_n;
+        while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            key = &st->c_keys[mid];
+            if (cli__key_cmp(key->name, key->len, str, s_len) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        for (; lo < st->c_n; lo++) {
+            key = &st->c_keys[lo];
+            if (key->len < s_len || memcmp(key->name, str, s_len) != 0) {
+                break;
+            }
+            cli__put(sk, key->name, key->len);
+            cli__put_c(sk, '\n');
+        }
+        return;
+    }
+
+    for (cmd = st->c_cmds; !IS_CMD_END(cmd); cmd++) {
+        if (strncmp(cmd->name, str, s_len) == 0) {
+            cli__put_s(sk, cmd->name);
+            cli__put_c(sk, '\n');
+        }
+    }
+}
+
+/**
+ * Print the options of sub-command `cmd` that `str` could be, a line each,
+ * long ones if it starts with `--`, and short ones too if it's just `-`.
+ */
+static void cli__complete_opts(
+    struct cli__sink *sk,
+    const struct clip_state *st,
+    const struct cli_sub_cmd *cmd,
+    const struct cli_index *idx,
+    const char *str)
+{
+    const struct cli_opt *opt, *first;
+    char chr;
+
+    if (cmd == NULL || cmd->opts == NULL) {
+        return;
+    }
+
+    if (str[1] == 0) {
+        for (opt = cmd->opts; !IS_OPT_END(cmd, opt); opt++) {
+            if ((opt->mode & ARG_ANYK) == 0 &&
+                opt->a_short > 0 && opt->a_short < 256 &&
+                isgraph(opt->a_short)) {
+                chr = (char)opt->a_short;
+                cli__put_c(sk, '-');
+                cli__put(sk, &chr, 1);
+                cli__put_c(sk, '\n');
+            }
+        }
+        str = "--";
+    }
+
+    cli__prefix_0(cmd, idx, &str[2], strlen(&str[2]), st, sk, "--", "\n",
+                  &first);
+}
+
+/**
+ * Whether `arg` leaves an option waiting for its value in the next argument.
+ */
+static int cli__complete_value(struct clip_state *st, const char *arg)
+{
+    const struct cli_sub_cmd *cmd;
+    const struct cli_opt *opt;
+    size_t i;
+
+    if (IS_LONG_OPT(arg)) {
+        if (strchr(arg, '=') != NULL) {
+            return 0;
+        }
+        opt = cli__find_opt(&cmd, st, &arg[2], strlen(&arg[2]));
+        return opt != NULL && (opt->mode & ARG_REQD) != 0;
+    } else if (!IS_SHORT_OPT(arg)) {
+        return 0;
+    }
+
+    /* The rest of a cluster, if any, is the value of the first that takes
+     * one.
+     */
+    for (i = 1; arg[i] != 0; i++) {
+        opt = cli__find_opt(&cmd, st, &arg[i], 1);
+        if (opt != NULL && (opt->mode & ARG_REQD) != 0) {
+            return arg[i + 1] == 0;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Answer `prog --clip-complete <index> <words...>`, which a shell runs to
+ * complete word `index` of `words`, `words[0]` being the program name. What
+ * that word could be, sub-commands or options if it starts with `-`, is
+ * printed to stdout a line each in one go. Nothing is printed for values,
+ * to leave those to the shell.
+ */
+static int cli__complete(
+    struct clip_state *st,
+    int argc,
+    const char *const *argv)
+{
+    struct cli__sink sk;
+    const char *const *words;
+    const char *word;
+    unsigned long at;
+    size_t n;
+    int i;
+#if CLIP_SUMMARY_BUFFER > 0
+    char buf[CLIP_SUMMARY_BUFFER];
+
+    sk.buf  = buf;
+    sk.size = sizeof(buf);
+#else
+    sk.buf  = NULL;
+    sk.size = 0;
+#endif
+    sk.out  = stdout;
+    sk.used = 0;
+    sk.len  = 0;
+    cli__sink_fbuf(&sk, st);
+
+    st->done = 1;
+    words    = &argv[3];
+    n        = strlen(argv[2]);
+    if (n == 0 || cli__ulong(argv[2], n, &at) != n ||
+        at < 1 || at > (unsigned long)(argc - 3)) {
+        return CLIP_ERR_HELP;
+    }
+
+    /* Sub-commands come first, as they do when parsing */
+    for (i = 1; (unsigned long)i < at && cli__sub_cmd(st, words[i]); i++) {
+        continue;
+    }
+
+    word = ((unsigned long)argc - 3 > at)? words[at]: "";
+    if (cli__complete_value(st, words[at - 1])) {
+        return CLIP_ERR_HELP;
+    }
+
+    if (word[0] != '-') {
+        if ((unsigned long)i == at) {
+            cli__complete_cmds(&sk, st, word, strlen(word));
+        }
+    } else if (word[1] == 0 || word[1] == '-') {
+        cli__complete_opts(&sk, st, st->live, st->l_idx, word);
+        if (st->live != st->clip->base) {
+            cli__complete_opts(&sk, st, st->clip->base, st->b_idx, word);
+        }
+
+        /* Then -h/--help and -v/--version, if they're given by the parser */
+        if (word[1] == 0 && (st->autos & AUTO_H) != 0) {
+            cli__put_s(&sk, "-h\n");
+        }
+        if (word[1] == 0 && (st->autos & AUTO_V) != 0) {
+            cli__put_s(&sk, "-v\n");
+        }
+        n = (word[1] == 0)? 0: strlen(&word[2]);
+        if ((st->autos & AUTO_HELP) != 0 &&
+            n <= 4 && memcmp(&word[2], "help", n) == 0) {
+            cli__put_s(&sk, "--help\n");
+        }
+        if ((st->autos & AUTO_VERSION) != 0 &&
+            n <= 7 && memcmp(&word[2], "version", n) == 0) {
+            cli__put_s(&sk, "--version\n");
+        }
+    }
+
+    if (sk.used > 0) {
+        fwrite(sk.buf, 1, sk.used, sk.out);
+    }
+    return CLIP_ERR_HELP;
+}
+
+/**
+ * Start parsing either `argc` arguments of `argv`, or if `argv` is NULL,
+ * `argc` words, one after another with a NUL after each, at `words`.
+ */
+static int cli__begin(
+    struct clip_state *st,
+    int argc,
+    const char *const *argv,
+    const char *words)
+{
+    unsigned which;
+    int i;
+    const char *arg;
+
+    if (st == NULL || st->clip == NULL) {
+        return CLIP_ERR_INVALID;
+    }
+
+    cli__reset(st, argc, argv, words);
+
+    /* There's no program name among words, nor maybe any argument at all */
+    i = (argv != NULL)? 1: 0;
+    st->index = (argc > i)? i: argc;
+
+    /* Asked by a shell to complete a word, nothing else is done */
+    if ((st->clip->flags & CLIP_FLAG_COMPLETE) != 0 &&
+        argv != NULL && argc >= 3 &&
+        strcmp(argv[1], "--clip-complete") == 0) {
+        return cli__complete(st, argc, argv);
+    }
+
+    /* We are at sub-commands part */
+    while (st->index < argc && cli__sub_cmd(st, cli__peek(st))) {
+        cli__take(st);
+    }
+
+    /* Unless asked to find them as we go, look for -h/--help and
+     * -v/--version before any option is given out.
+     */
+    if (st->autos != 0 && (st->clip->flags & CLIP_FLAG_SINGLE_PASS) == 0) {
+        arg = words;
+        for (i = st->index; i < argc; i++) {
+            if (argv != NULL) {
+                arg = argv[i];
+            } else if (i > st->index) {
+                arg += strlen(arg) + 1;
+            } else {
+                arg = st->w_next;
+            }
+
+            if (IS_SLICE(st) && IS_DOUBLE_DASH(arg)) {
+                break;
+            }
+            if ((which = cli__auto_match(st->autos, arg)) != 0) {
+                st->done = 1;
+                return cli__auto_show(st, which);
+            }
+        }
+    }
+
+    if (st->clip->env_prefix != NULL) {
+        st->e_pos = st->clip->envp;
+    }
+    return CLIP_ERR_OK;
+}
+
+int cli_begin(struct clip_state *st, int argc, char **argv)
+{
+    return cli__begin(st, argc, (const char *const *)argv, NULL);
+}
+
+int cli_begin_const(struct clip_state *st, int argc, const char *const *argv)
+{
+    if (argv == NULL) {
+        return CLIP_ERR_INVALID;
+    }
+
+    return cli__begin(st, argc, argv, NULL);
+}
+
+int cli_begin_line(struct clip_state *st, char *buf, size_t len)
+{
+    int n, r;
+
+    if (st == NULL || buf == NULL) {
+        return CLIP_ERR_INVALID;
+    }
+
+    if ((r = cli__words(st, buf, len, &n)) != CLIP_ERR_OK) {
+        return r;
+    }
+
+    return cli__begin(st, n, NULL, buf);
+}
+
+/**
+ * Get the next switch out of a cluster of short options. Returns NEXT_NONE once
+ * the cluster is done.
+ */
+static int cli__next_short(struct clip_state *st, struct cli_token *tok)
+{
+    FILE *out;
+    const char *arg, *val;
+    char chr;
+    const struct cli_opt *opt;
+    const struct cli_sub_cmd *cmd;
+
+    arg = st->arg;
+    while (arg[st->a_pos] != 0) {
+        chr = arg[st->a_pos++];
+
+        opt = cli__find_opt(&cmd, st, &chr, 1);
+        if (opt == NULL) {
+            out = (st->clip->out != NULL)? st->clip->out: stderr;
+            cli_bad_arg(out, st->clip->flags, 1, "Invalid option:", &chr, 1);
+            return CLIP_ERR_BAD_ARG;
+        }
+
+        tok->opt   = opt;
+        tok->cmd   = cmd;
+        tok->value = NULL;
+        tok->len   = 0;
+        tok->index = st->a_index;
+
+        if (IS_SWITCH(opt)) {
+            return CLIP_ERR_OK;
+        } else if ((opt->mode & ARG_REQD) != 0) {
+            /* The rest of the cluster, or the next argument, is the value */
+            val = NULL;
+            if (arg[st->a_pos] != 0) {
+                val = &arg[st->a_pos];
+            } else if (st->index < st->argc) {
+                val = cli__take(st);
+            }
+            st->arg = NULL;
+
+            if (val == NULL && st->feed) {
+                /* The value is whatever is fed next */
+                st->p_opt   = opt;
+                st->p_cmd   = cmd;
+                st->p_short = 1;
+                return NEXT_NONE;
+            } else if (val == NULL) {
+                out = (st->clip->out != NULL)? st->clip->out: stderr;
+                cli_bad_arg(
+                    out,
+                    st->clip->flags,
+                    1,
+                    "Missing required value for",
+                    &chr,
+                    1
+                );
+                return CLIP_ERR_BAD_ARG;
+            }
+
+            tok->value = val;
+            tok->len   = strlen(val);
+            return CLIP_ERR_OK;
+        }
+    }
+
+    st->arg = NULL;
+    return NEXT_NONE;
+}
+
+/**
+ * Give positional argument `arg` to the NARGS option of the live sub-command,
+ * along with those that follow it as a slice if asked to.
+ */
+static int cli__next_any(
+    struct clip_state *st,
+    struct cli_token *tok,
+    const char *arg)
+{
+    const char *next;
+
+    if (st->any_cmd != st->live) {
+        st->any     = cli__find_any(st->live);
+        st->any_cmd = st->live;
+    }
+
+    if (st->any == NULL) {
+        cli_bad_arg(
+            (st->clip->out != NULL)? st->clip->out: stderr,
+            st->clip->flags,
+            0,
+            "Unrecognised option:",
+            arg,
+            strlen(arg)
+        );
+        return CLIP_ERR_BAD_ARG;
+    }
+
+    tok->opt   = st->any;
+    tok->cmd   = st->live;
+    tok->index = st->index - 1;
+    if (!IS_SLICE(st)) {
+        tok->value = arg;
+        tok->len   = strlen(arg);
+        return CLIP_ERR_OK;
+    }
+
+    /* Up to the next that isn't positional, or all after `--` */
+    for (; st->index < st->argc; st->index++) {
+        next = st->argv[st->index];
+        if (!st->dashed &&
+            (next[0] == '@' || IS_SHORT_OPT(next) || IS_LONG_OPT(next) ||
+             IS_DOUBLE_DASH(next))) {
+            break;
+        }
+    }
+    tok->value = NULL;
+    tok->len   = (size_t)(st->index - tok->index);
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Get the next option out of the arguments vector. Returns NEXT_NONE if the
+ * argument doesn't give one by itself.
+ */
+static int cli__next_arg(struct clip_state *st, struct cli_token *tok)
+{
+    FILE *out;
+    const char *arg, *key, *eq, *val;
+    size_t len;
+    unsigned which;
+    int keep, r;
+    const struct cli_opt *opt;
+    const struct cli_sub_cmd *cmd;
+
+    out = (st->clip->out != NULL)? st->clip->out: stderr;
+    arg = cli__take(st);
+
+    if (st->dashed) {
+        return cli__next_any(st, tok, arg);
+    }
+
+    /* When fed, there's nothing to look ahead at */
+    if (((st->clip->flags & CLIP_FLAG_SINGLE_PASS) != 0 || st->feed) &&
+        (which = cli__auto_match(st->autos, arg)) != 0) {
+        return cli__auto_show(st, which);
+    }
+
+    if (IS_SHORT_OPT(arg)) {
+        st->arg     = arg;
+        st->a_pos   = 1;
+        st->a_index = st->index - 1;
+        return NEXT_NONE;
+    } else if (IS_LONG_OPT(arg)) {
+        key = &arg[2];
+        if ((eq = strchr(key, '=')) != NULL) {
+            len = (size_t)(eq - key);
+        } else {
+            len = strlen(key);
+        }
+
+        opt = cli__match_opt(&cmd, st, key, len, 2);
+        if (opt == NULL) {
+            return CLIP_ERR_BAD_ARG;
+        }
+
+        tok->opt   = opt;
+        tok->cmd   = cmd;
+        tok->value = NULL;
+        tok->len   = 0;
+        tok->index = st->index - 1;
+
+        if (IS_SWITCH(opt)) {
+            return CLIP_ERR_OK;
+        } else if ((opt->mode & ARG_REQD) != 0) {
+            val = NULL;
+            if (eq != NULL) {
+                val = eq + 1;
+            } else if (st->index < st->argc) {
+                val = cli__take(st);
+            }
+
+            if (val == NULL && st->feed) {
+                st->p_opt   = opt;
+                st->p_cmd   = cmd;
+                st->p_short = 0;
+                return NEXT_NONE;
+            } else if (val == NULL) {
+                cli_bad_arg(
+                    out,
+                    st->clip->flags,
+                    2,
+                    "Missing required value for",
+                    key,
+                    len
+                );
+                return CLIP_ERR_BAD_ARG;
+            }
+
+            tok->value = val;
+            tok->len   = strlen(val);
+            return CLIP_ERR_OK;
+        }
+        return NEXT_NONE;
+    } else if (arg[0] == '@') {
+        /* Read arguments from file */
+        key  = &arg[1];
+        len  = strlen(key);
+        keep = 1;
+        if (st->feed) {
+            /*
+             * A fed argument is overwritten by the next one, so the name is
+             * copied to fbuf to tell the file apart later, if there's room
+             */
+            keep = st->fbuf != NULL && st->f_top - st->f_used > len;
+            if (keep) {
+                st->f_top -= len + 1;
+                memcpy(&st->fbuf[st->f_top], key, len + 1);
+                key = &st->fbuf[st->f_top];
+            }
+        }
+        r = cli__file_push(st, key, len, keep);
+        return (r == CLIP_ERR_OK)? NEXT_NONE: r;
+    } else if (IS_DOUBLE_DASH(arg)) {
+        st->dashed = 1;
+        return (IS_SLICE(st))? NEXT_NONE: CLIP_ERR_END;
+    }
+
+    return cli__next_any(st, tok, arg);
+}
+
+/**
+ * Get the next option from wherever parsing has got to. Returns CLIP_ERR_END
+ * when there's nothing left to parse.
+ */
+static int cli__step(struct clip_state *st, struct cli_token *tok)
+{
+    int r;
+
+    for (;;) {
+        if (st->f_depth > 0) {
+            r = cli__file_next(st, tok);
+        } else if (st->arg != NULL) {
+            r = cli__next_short(st, tok);
+        } else if (st->index < st->argc) {
+            r = cli__next_arg(st, tok);
+        } else {
+            r = CLIP_ERR_END;
+        }
+
+        if (r != NEXT_NONE) {
+            break;
+        }
+    }
+
+    if (r == CLIP_ERR_OK) {
+        STAT_ADD(st, tokens, 1);
+        r = cli__attr_seen(st, tok);
+    }
+    return r;
+}
+
+int cli_next(struct clip_state *st, struct cli_token *tok)
+{
+    int r;
+
+    if (st == NULL || tok == NULL) {
+        return CLIP_ERR_INVALID;
+    }
+    if (st->done) {
+        return CLIP_ERR_END;
+    }
+
+    /* Sub-commands that were matched come first */
+    if (st->c_next < st->depth) {
+        tok->opt   = NULL;
+        tok->cmd   = st->trail[st->c_next];
+        tok->value = NULL;
+        tok->len   = 0;
+        tok->index = ++st->c_next;
+        STAT_ADD(st, tokens, 1);
+        return CLIP_ERR_OK;
+    }
+
+    /* Once the arguments are parsed, the environment gives what they didn't */
+    st->v_tmp = 0;
+    r = cli__step(st, tok);
+    if (r == CLIP_ERR_END && st->e_pos != NULL) {
+        r = cli__env_next(st, tok);
+        if (r == CLIP_ERR_OK) {
+            STAT_ADD(st, tokens, 1);
+            st->v_tmp = 0;
+            r = cli__attr_seen(st, tok);
+        } else if (r == NEXT_NONE) {
+            r = CLIP_ERR_END;
+        }
+    }
+    if (r == CLIP_ERR_END && cli__attr_end(st) != CLIP_ERR_OK) {
+        r = CLIP_ERR_BAD_ARG;
+    }
+    if (r != CLIP_ERR_OK) {
+        st->done = 1;
+    }
+    return r;
+}
+
+void cli_end(struct clip_state *st)
+{
+    if (st == NULL) {
+        return;
+    }
+
+    cli__files_done(st);
+    st->arg  = NULL;
+    st->done = 1;
+}
+
+int cli_state_init(struct clip_state *st, const struct clip *clip)
+{
+    if (st == NULL || clip == NULL) {
+        return CLIP_ERR_INVALID;
+    }
+
+    memset(st, 0, sizeof(struct clip_state));
+    st->clip     = clip;
+    st->usr      = clip->usr;
+    st->fbuf     = clip->fbuf;
+    st->fbuf_len = clip->fbuf_len;
+    st->toks     = clip->toks;
+    st->n_toks   = clip->n_toks;
+    st->result   = clip->result;
+#ifdef CLIP_STATS
+    st->stats    = clip->stats;
+#endif
+
+    return CLIP_ERR_OK;
+}
+
+int cli_parse_r(struct clip_state *st, int argc, char **argv)
+{
+    return cli_parse_const(st, argc, (const char *const *)argv);
+}
+
+/**
+ * Copy the value of a token that won't last to the top of `fbuf`.
+ */
+static int cli__keep(struct clip_state *st, struct cli_token *tok)
+{
+    char *val;
+
+    if (st->fbuf == NULL || st->f_top - st->f_used <= tok->len) {
+        cli_bad_arg(
+            (st->clip->out != NULL)? st->clip->out: stderr,
+            st->clip->flags,
+            0,
+            "No room to keep value:",
+            tok->value,
+            tok->len
+        );
+        return CLIP_ERR_BAD_ARG;
+    }
+
+    st->f_top -= tok->len + 1;
+    val = &st->fbuf[st->f_top];
+    memcpy(val, tok->value, tok->len);
+    val[tok->len] = 0;
+    tok->value = val;
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Whether the option of `tok` was given to cli__hold() before, marking it as
+ * given if not. Past what `st->marks` has room for, it's never told.
+ */
+static int cli__given(struct clip_state *st, const struct cli_token *tok)
+{
+    unsigned char *given;
+    unsigned bit;
+    size_t i;
+
+    i = (size_t)(tok->opt - tok->cmd->opts);
+    if (i >= st->m_bytes * ATTR_BITS) {
+        return 0;
+    }
+
+    given = cli__marks(st, tok->cmd, MARK_GIVEN);
+    bit   = 1U << (i % ATTR_BITS);
+    if ((given[i / ATTR_BITS] & bit) != 0) {
+        return 1;
+    }
+    given[i / ATTR_BITS] |= (unsigned char)bit;
+
+    return 0;
+}
+
+/**
+ * Hold the token of an option with ::CLI_ATTR_LAST or ::CLI_ATTR_FIRST until
+ * cli__flush(). Values that won't last, as told by `tmp`, are kept in `fbuf`.
+ * Without room there, or in `hold`, an option with ::CLI_ATTR_FIRST is invoked
+ * right away, as later values are dropped, while one with ::CLI_ATTR_LAST
+ * fails rather than be invoked more than once.
+ */
+static int cli__hold(
+    struct clip_state *st,
+    const struct cli_token *tok,
+    int tmp)
+{
+    size_t i;
+    int held, room;
+
+    for (i = 0; i < st->h_n; i++) {
+        if (st->hold[i].opt == tok->opt) {
+            break;
+        }
+    }
+    held = i < st->h_n;
+
+    if ((tok->opt->attr & CLI_ATTR_FIRST) != 0 &&
+        (held || cli__given(st, tok))) {
+        /* The first given stays, whether it's held or was invoked already */
+        return CLIP_ERR_OK;
+    }
+    if (st->hold == NULL || st->n_hold == 0) {
+        /* Nothing's held, options are invoked as they're given */
+        return cli__call(st, tok);
+    }
+
+    room = !tmp ||
+        tok->value == NULL ||
+        (st->fbuf != NULL && st->f_top - st->f_used > tok->len);
+    if ((!held && st->h_n >= st->n_hold) || !room) {
+        if ((tok->opt->attr & CLI_ATTR_FIRST) != 0) {
+            return cli__call(st, tok);
+        }
+        cli__bad_value(
+            st->clip,
+            tok->opt,
+            room? "No room to hold": "No room to keep value of"
+        );
+        return CLIP_ERR_BAD_ARG;
+    }
+
+    if (!held) {
+        st->h_n++;
+    }
+    st->hold[i] = *tok;
+    if (tmp && tok->value != NULL) {
+        cli__keep(st, &st->hold[i]);
+    }
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Number of options in the table of `cmd`.
+ */
+static size_t cli__n_opts(const struct cli_sub_cmd *cmd)
+{
+    const struct cli_opt *opt;
+
+    if (cmd == NULL || cmd->opts == NULL) {
+        return 0;
+    }
+
+    for (opt = cmd->opts; !IS_OPT_END(cmd, opt); opt++) {
+        ;
+    }
+    return (size_t)(opt - cmd->opts);
+}
+
+/**
+ * Entry of `opt` in a result, options of the sub-command first and then those
+ * of the base. Returns `res->n_all` if it has none.
+ */
+static size_t cli__seen_at(
+    const struct cli_result *res,
+    const struct cli_opt *opt)
+{
+    const struct cli_sub_cmd *cmd;
+
+    cmd = res->cmd;
+    if (cmd != NULL && cmd->opts != NULL &&
+        opt >= cmd->opts && (size_t)(opt - cmd->opts) < res->n_cmd) {
+        return (size_t)(opt - cmd->opts);
+    }
+
+    cmd = res->base;
+    if (cmd != NULL && cmd != res->cmd && cmd->opts != NULL &&
+        opt >= cmd->opts &&
+        (size_t)(opt - cmd->opts) < res->n_all - res->n_cmd) {
+        return res->n_cmd + (size_t)(opt - cmd->opts);
+    }
+
+    return res->n_all;
+}
+
+/**
+ * Lay out the result for the sub-command selected, which empties it if it
+ * was laid out for another.
+ */
+static int cli__result_cmd(struct clip_state *st)
+{
+    struct cli_result *res;
+    size_t n_cmd, n_all;
+
+    res = st->result;
+    if (res->cmd == st->live && res->base == st->clip->base) {
+        return CLIP_ERR_OK;
+    }
+
+    n_cmd = cli__n_opts(st->live);
+    n_all = n_cmd;
+    if (st->clip->base != st->live) {
+        n_all += cli__n_opts(st->clip->base);
+    }
+    if (n_all > res->n_seen || (n_all > 0 && res->seen == NULL)) {
+        return CLIP_ERR_INVALID;
+    }
+
+    if (n_all > 0) {
+        memset(res->seen, 0, n_all * sizeof(struct cli_seen));
+    }
+    res->cmd    = st->live;
+    res->base   = st->clip->base;
+    res->n_cmd  = n_cmd;
+    res->n_all  = n_all;
+    res->a_used = 0;
+    res->b_used = 0;
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Count an option given at `index` in `seen`, and copy its value, if any, to
+ * the result. A positional argument is listed as well.
+ */
+static int cli__result_add(
+    struct clip_state *st,
+    struct cli_seen *seen,
+    int index,
+    const char *value,
+    size_t len,
+    int arg)
+{
+    struct cli_result *res;
+    char *val;
+
+    res = st->result;
+    if (value == NULL) {
+        if (seen->count++ == 0) {
+            seen->index = index;
+        }
+        return CLIP_ERR_OK;
+    }
+
+    if (res->buf == NULL ||
+        res->buf_len - res->b_used <= len ||
+        (arg && res->a_used >= res->n_args)) {
+        cli_bad_arg(
+            (st->clip->out != NULL)? st->clip->out: stderr,
+            st->clip->flags,
+            0,
+            "No room to keep value:",
+            value,
+            len
+        );
+        return CLIP_ERR_BAD_ARG;
+    }
+
+    if (seen->count++ == 0) {
+        seen->index = index;
+    }
+    val = &res->buf[res->b_used];
+    memcpy(val, value, len);
+    val[len]     = 0;
+    res->b_used += len + 1;
+    seen->value  = val;
+    seen->len    = len;
+    if (arg) {
+        res->args[res->a_used++] = val;
+    }
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Keep what's given of the option of `tok` in the result, see ::cli_result.
+ */
+static int cli__result_put(struct clip_state *st, const struct cli_token *tok)
+{
+    struct cli_result *res;
+    struct cli_seen *seen;
+    const char *arg;
+    size_t i;
+    int r, pos;
+
+    res = st->result;
+    if ((r = cli__result_cmd(st)) != CLIP_ERR_OK) {
+        return r;
+    }
+    if ((i = cli__seen_at(res, tok->opt)) == res->n_all) {
+        return CLIP_ERR_OK;
+    }
+
+    seen = &res->seen[i];
+    pos  = (tok->opt->mode & ARG_ANYK) != 0;
+    if (pos && tok->value == NULL) {
+        /* A slice of positional arguments */
+        for (i = 0, r = CLIP_ERR_OK; i < tok->len && r == CLIP_ERR_OK; i++) {
+            arg = st->argv[tok->index + (int)i];
+            r   = cli__result_add(
+                st,
+                seen,
+                tok->index + (int)i,
+                arg,
+                strlen(arg),
+                1
+            );
+        }
+        return r;
+    }
+
+    return cli__result_add(st, seen, tok->index, tok->value, tok->len, pos);
+}
+
+/**
+ * Give a token to its call-back, or hold it for later if its option says so.
+ */
+static int cli__give(
+    struct clip_state *st,
+    const struct cli_token *tok,
+    int tmp)
+{
+    int r;
+
+    if (st->result != NULL && (r = cli__result_put(st, tok)) != CLIP_ERR_OK) {
+        return r;
+    }
+
+    if ((tok->opt->attr & ATTR_HOLD) != 0) {
+        return cli__hold(st, tok, tmp);
+    }
+    return cli__call(st, tok);
+}
+
+/**
+ * Invoke call-backs held by cli__hold(), in the order that options were first
+ * given.
+ */
+static int cli__flush(struct clip_state *st)
+{
+    size_t i, n;
+    int r;
+
+    /* With no option given, the result is still for the sub-command */
+    if (st->result != NULL && (r = cli__result_cmd(st)) != CLIP_ERR_OK) {
+        return r;
+    }
+
+    n = st->h_n;
+    st->h_n = 0;
+    for (i = 0; i < n; i++) {
+        if ((r = cli__call(st, &st->hold[i])) != CLIP_ERR_OK) {
+            return r;
+        }
+    }
+
+    return CLIP_ERR_OK;
+}
+
+/**
+ * Invoke call-backs for all options, once parsing has begun.
+ */
+static int cli__run(struct clip_state *st)
+{
+    struct cli_token tok;
+    int r;
 
-    if (cmd == clip->base && clip->cmds != NULL) {
-        cli__puts(
-            out,
-            (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_CMD: NULL,
-            NULL,
-            NULL,
-            " [COMMAND]",
-            0
-        );
+    while ((r = cli_next(st, &tok)) == CLIP_ERR_OK) {
+        /* Sub-commands aren't given to call-backs */
+        if (tok.opt == NULL) {
+            continue;
+        }
+
+        r = cli__give(st, &tok, st->v_tmp);
+        if (r != CLIP_ERR_OK) {
+            break;
+        }
     }
-    if (cmd != NULL) {
-        char cmd_name[CLIP_BUFFER_SIZE] = {0};
 
-        cmd_name[0] = ' ';
-        strcpy(&cmd_name[1], cmd->name);
-        cli__puts(
-            out,
-            (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_OPT: NULL,
-            cmd_name,
-            NULL,
-            " [OPTIONS]",
-            0);
+    if (r == CLIP_ERR_END) {
+        r = cli__flush(st);
     }
-    if (any != NULL) {
-        cli__puts(
-            out,
-            (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_ANY: NULL,
-            " ",
-            "...",
-            any->tag,
-            0);
+    cli_end(st);
+    return r;
+}
+
+int cli_parse_const(struct clip_state *st, int argc, const char *const *argv)
+{
+    int r;
+
+    if ((r = cli_begin_const(st, argc, argv)) != CLIP_ERR_OK) {
+        return r;
     }
-    fprintf(out, "\n");
 
-    if (clip->header != NULL) {
-        fprintf(out, "%s\n", clip->header);
+    return cli__run(st);
+}
+
+int cli_parse_line(struct clip_state *st, char *buf, size_t len)
+{
+    int r;
+
+    if ((r = cli_begin_line(st, buf, len)) != CLIP_ERR_OK) {
+        return r;
     }
 
-    /* If there are sub-commands and this is base/default options, show
-     * sub-commands too
-     */
-    if (cmd == clip->base && clip->cmds != NULL) {
-        const struct cli_sub_cmd *sub;
+    return cli__run(st);
+}
 
-        fprintf(out, "\nSub-commands:\n");
-        for (sub = clip->cmds; sub->opts != NULL; sub++) {
-            cli__puts(
-                out,
-                (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_CMD: NULL,
-                "\t",
-                "\n",
-                sub->name,
-                0
-            );
-        }
+int cli_parse(struct clip *clip, int argc, char **argv)
+{
+    struct clip_state st;
+    struct cli_src srcs[CLIP_FILE_DEPTH];
+    struct cli_file files[CLIP_FILE_MAX];
+    struct cli_token hold[CLIP_HOLD_MAX];
+    unsigned char marks[CLIP_MARKS(CLIP_ATTR_MAX)];
+#if CLIP_PARSE_BUFFER > 0
+    char line[CLIP_PARSE_BUFFER];
+#endif
+    int r;
+
+    if (clip == NULL) {
+        return CLIP_ERR_INVALID;
+    }
+    if (clip->index != 0) {
+        return CLIP_ERR_INVALID;
     }
 
-    if (FLAGS_HAS_AUTO(clip->flags)) {
-        cli__puts(
-            out,
-            (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_SUBTITLE: NULL,
-            "\n",
-            "\n",
-            "Default Options:",
-            0
-        );
-        if ((clip->flags & CLIP_FLAG_HELP) != 0) {
-            if (cmd == clip->base && clip->cmds != NULL) {
-                cli__put_opt(
-                    out,
-                    clip->flags & CLIP_FLAG_USE_ANSI,
-                    &def_help_cmds
-                );
-            } else {
-                cli__put_opt(
-                    out,
-                    clip->flags & CLIP_FLAG_USE_ANSI,
-                    &def_help_base
-                );
-            }
-        }
+    cli_state_init(&st, clip);
+#if CLIP_PARSE_BUFFER > 0
+    /* Without a buffer, arguments files are read a line at a time */
+    if (st.fbuf == NULL) {
+        st.fbuf     = line;
+        st.fbuf_len = sizeof(line);
+    }
+#endif
+    st.srcs    = srcs;
+    st.n_srcs  = CLIP_FILE_DEPTH;
+    st.files   = files;
+    st.n_files = CLIP_FILE_MAX;
+    st.hold    = hold;
+    st.n_hold  = CLIP_HOLD_MAX;
+    st.marks   = marks;
+    st.n_marks = sizeof(marks);
 
-        if ((clip->flags & CLIP_FLAG_VERSION) != 0) {
-            const struct cli_opt *ver;
+    r = cli_parse_r(&st, argc, argv);
+    clip->index = st.index;
 
-            ver = cli__find_opt_0(clip->base, "v");
-            if (ver != NULL) {
-                def_version.a_short = 0;
-            }
+    return r;
+}
 
-            cli__put_opt(
-                out,
-                clip->flags & CLIP_FLAG_USE_ANSI,
-                &def_version
-            );
+/**
+ * Invoke call-backs for the options given in the environment and not by the
+ * arguments, for parsing that doesn't go through cli_next().
+ */
+static int cli__env_feed(struct clip_state *st)
+{
+    struct cli_token tok;
+    int r;
+
+    while (st->e_pos != NULL) {
+        if ((r = cli__env_next(st, &tok)) != CLIP_ERR_OK) {
+            return (r == NEXT_NONE)? CLIP_ERR_OK: r;
+        }
+        STAT_ADD(st, tokens, 1);
+        if ((r = cli__attr_seen(st, &tok)) != CLIP_ERR_OK ||
+            (r = cli__give(st, &tok, 0)) != CLIP_ERR_OK) {
+            return r;
         }
     }
 
-    if (cmd != NULL) {
-        const struct cli_opt *opt;
+    return CLIP_ERR_OK;
+}
 
-        cli__puts(
-            out,
-            (clip->flags & CLIP_FLAG_USE_ANSI) != 0? ANSI_SUBTITLE: NULL,
-            "\n",
-            "\n",
-            (cmd == clip->base)? "Common options:": "Options:",
-            0
+int cli_feed_begin(struct clip_state *st)
+{
+    if (st == NULL || st->clip == NULL) {
+        return CLIP_ERR_INVALID;
+    }
+
+    cli__reset(st, 0, NULL, NULL);
+    if (st->line == NULL) {
+        /* Arguments are copied to be split, as they needn't last */
+        return CLIP_ERR_INVALID;
+    }
+    st->feed = 1;
+    if (st->clip->env_prefix != NULL) {
+        st->e_pos = st->clip->envp;
+    }
+
+    return CLIP_ERR_OK;
+}
+
+int cli_feed(struct clip_state *st, const char *token, size_t len)
+{
+    struct cli_token tok;
+    const struct cli_opt *opt;
+    int r;
+
+    if (st == NULL || token == NULL || !st->feed) {
+        return CLIP_ERR_INVALID;
+    }
+    if (st->done) {
+        return CLIP_ERR_END;
+    }
+
+    if (len >= st->line_len) {
+        cli_bad_arg(
+            (st->clip->out != NULL)? st->clip->out: stderr,
+            st->clip->flags,
+            0,
+            "Argument too long:",
+            token,
+            len
         );
-        for (opt = cmd->opts; !IS_OPT_END(opt); opt++) {
-            if (opt->help == NULL) {
-                continue;
+        st->done = 1;
+        return CLIP_ERR_BAD_ARG;
+    }
+    memcpy(st->line, token, len);
+    st->line[len] = 0;
+
+    if ((opt = st->p_opt) != NULL) {
+        /* The value an option was left waiting for */
+        tok.opt   = opt;
+        tok.cmd   = st->p_cmd;
+        tok.value = st->line;
+        tok.len   = len;
+        tok.index = st->index - 1;
+        st->p_opt = NULL;
+        st->index++;
+        STAT_ADD(st, tokens, 1);
+        r = cli__attr_seen(st, &tok);
+        if (r == CLIP_ERR_OK) {
+            r = cli__give(st, &tok, 1);
+        }
+    } else if (cli__sub_cmd(st, st->line)) {
+        st->index++;
+        st->c_next = st->depth;
+        STAT_ADD(st, tokens, 1);
+        r = CLIP_ERR_OK;
+    } else {
+        /* Parse it as the one argument there is */
+        st->argc   = st->index + 1;
+        st->w_next = st->line;
+        while ((r = cli__step(st, &tok)) == CLIP_ERR_OK) {
+            r = cli__give(st, &tok, 1);
+            if (r != CLIP_ERR_OK) {
+                break;
+            }
+        }
+        if (r == CLIP_ERR_END && !st->dashed) {
+            r = CLIP_ERR_OK;
+        } else if (r == CLIP_ERR_END) {
+            /* That's the end of options, given by `--` */
+            r = cli__env_feed(st);
+            if (r == CLIP_ERR_OK) {
+                r = cli__attr_end(st);
+            }
+            if (r == CLIP_ERR_OK) {
+                r = cli__flush(st);
+            }
+            if (r == CLIP_ERR_OK) {
+                r = CLIP_ERR_END;
             }
-            cli__put_opt(out, clip->flags & CLIP_FLAG_USE_ANSI, opt);
         }
     }
 
-    if (clip->footer != NULL) {
-        fprintf(out, "\n%s\n", clip->footer);
+    if (r != CLIP_ERR_OK) {
+        st->done = 1;
     }
-
-    return 0;
+    return r;
 }
 
-int cli_parse(struct clip *clip, int argc, char **argv)
+int cli_feed_end(struct clip_state *st)
 {
     FILE *out;
-    size_t len;
-    const struct cli_sub_cmd *cmd;
-    int i;
-    int r;
-    char *arg;
     const struct cli_opt *opt;
+    char chr;
+    int r;
 
-    if (clip == NULL) {
+    if (st == NULL || !st->feed) {
         return CLIP_ERR_INVALID;
     }
-    if (clip->index != 0) {
+
+    r = CLIP_ERR_OK;
+    if ((opt = st->p_opt) != NULL) {
+        out = (st->clip->out != NULL)? st->clip->out: stderr;
+        if (st->p_short) {
+            chr = (char)opt->a_short;
+            cli_bad_arg(
+                out,
+                st->clip->flags,
+                1,
+                "Missing required value for",
+                &chr,
+                1
+            );
+        } else {
+            cli_bad_arg(
+                out,
+                st->clip->flags,
+                2,
+                "Missing required value for",
+                opt->a_long,
+                strlen(opt->a_long)
+            );
+        }
+        st->p_opt = NULL;
+        r = CLIP_ERR_BAD_ARG;
+    } else if (!st->done) {
+        r = cli__env_feed(st);
+        if (r == CLIP_ERR_OK) {
+            r = cli__attr_end(st);
+        }
+        if (r == CLIP_ERR_OK) {
+            r = cli__flush(st);
+        }
+    }
+
+    cli_end(st);
+    st->feed = 0;
+
+    return r;
+}
+
+int cli_tokenize(
+    struct clip_state *st,
+    int argc,
+    char **argv,
+    struct cli_token *toks,
+    size_t n_toks,
+    size_t *count)
+{
+    struct cli_token tok;
+    unsigned long u;
+    size_t n;
+    long l;
+    int r;
+
+    if (toks == NULL || count == NULL) {
         return CLIP_ERR_INVALID;
     }
+    *count = 0;
 
-    out = (clip->out != NULL)? clip->out: stderr;
+    if ((r = cli_begin(st, argc, argv)) != CLIP_ERR_OK) {
+        return r;
+    }
+
+    n = 0;
+    while ((r = cli_next(st, &tok)) == CLIP_ERR_OK) {
+        if (n >= n_toks) {
+            st->done = 1;
+            r = CLIP_ERR_INVALID;
+            break;
+        }
+        if (st->v_tmp && (r = cli__keep(st, &tok)) != CLIP_ERR_OK) {
+            st->done = 1;
+            break;
+        }
+        /* Typed values are checked now, but stored by cli_dispatch() */
+        if (tok.opt != NULL &&
+            (tok.opt->mode & ARG_TYPE) != 0 &&
+            (r = cli__value(st->clip, tok.opt, tok.value, tok.len, &l, &u))
+                != CLIP_ERR_OK) {
+            st->done = 1;
+            break;
+        }
+        toks[n++] = tok;
+    }
 
-    /* Primary index */
-    clip->index = 0;
+    *count = n;
+    return (r == CLIP_ERR_END)? CLIP_ERR_OK: r;
+}
 
-    if (argc > 1) {
-        clip->index++;
-    } else {
-        /* No more arguments to parse, exit */
-        return CLIP_ERR_OK;
+int cli_dispatch(
+    struct clip_state *st,
+    const struct cli_token *toks,
+    size_t n_toks)
+{
+    size_t i;
+    int r;
+
+    if (st == NULL || (toks == NULL && n_toks > 0)) {
+        return CLIP_ERR_INVALID;
     }
 
-    /* We start at the base defaults */
-    clip->live = clip->base;
-    /* We are at sub-commands part */
-    if (isalnum(argv[clip->index][0])) {
-        /* 2 things can happen here:
-         *  ->    This is a sub-command, so match for it.
-         *  ->(*) Otherwise, if the base has NARGS, then feed this to it.
-         *
-         * We do the first one here, but let it roll into the massive loop
-         * later for NARGS matching.
-         */
-        if (clip->cmds != NULL) {
-            cmd = cli__find_cmd(clip, argv[clip->index]);
-            if (cmd) {
-                clip->live = cmd;
-                clip->index++;
-            }
-        }
-    }
-
-    for (i = clip->index; i < argc; i++) {
-        int show;
-
-        arg = argv[i];
-
-        /* Check for -h or --help */
-        show  =
-            arg[0] == '-' &&
-            arg[1] == 'h' &&
-            cli__find_opt_0(clip->base, "h") == NULL;
-        if (!show) {
-            len  = strlen(arg);
-            show =
-                len > 6 &&
-                memcmp(arg, "--help", 6) == 0 &&
-                cli__find_opt_0(clip->base, "help") == NULL;
-        }
-        /* Only if automatic help was requested, else pass it to call-back */
-        show &= (clip->flags & CLIP_FLAG_HELP) != 0;
-        if (show) {
-            cli_summary(clip, clip->live);
-            return CLIP_ERR_HELP;
-        }
-
-        /* Check for -v or --version */
-        show =
-            arg[0] == '-' &&
-            arg[1] == 'v' &&
-            cli__find_opt_0(clip->base, "v") == NULL;
-        if (!show) {
-            len = strlen(arg);
-            show =
-                len >= 9 &&
-                memcmp(arg, "--version", 9) == 0 &&
-                cli__find_opt_0(clip->base, "version") == NULL;
-        }
-        show &=
-            (clip->flags & CLIP_FLAG_VERSION) != 0 &&
-            clip->version != NULL;
-        if (show) {
-            if ((clip->flags & CLIP_FLAG_USE_ANSI) != 0) {
-                fprintf(
-                    out,
-                    ANSI_PROG "%s" ANSI_END " %s\n",
-                    clip->progname,
-                    clip->version
-                );
-            } else {
-                fprintf(out, "%s %s\n", clip->progname, clip->version);
-            }
-            return CLIP_ERR_HELP;
+    /* Nothing's been given yet, however often these tokens were before */
+    if (st->m_bytes > 0) {
+        memset(cli__marks(st, st->clip->base, MARK_GIVEN), 0, 2 * st->m_bytes);
+    }
+    st->h_n = 0;
+    if (st->result != NULL) {
+        st->result->cmd = NULL;
+    }
+
+    for (i = 0; i < n_toks; i++) {
+        /* Sub-commands aren't given to call-backs */
+        if (toks[i].opt == NULL) {
+            continue;
+        }
+
+        r = cli__give(st, &toks[i], 0);
+        if (r != CLIP_ERR_OK) {
+            return r;
         }
     }
 
-    r = 0;
+    return cli__flush(st);
+}
 
-    while (clip->index < argc) {
-        arg = argv[clip->index++];
+/**
+ * Most options of any sub-command in `cmds`, nested ones included.
+ */
+static size_t cli__result_size(const struct cli_sub_cmd *cmds)
+{
+    const struct cli_sub_cmd *cmd;
+    size_t n, max;
 
-        if (IS_SHORT_OPT(arg)) {
-            int c;
+    if (cmds == NULL) {
+        return 0;
+    }
 
-            i = 1;
-            do {
-                char chr[2];
+    max = 0;
+    for (cmd = cmds; !IS_CMD_END(cmd); cmd++) {
+        n   = cli__n_opts(cmd);
+        max = (n > max)? n: max;
+        n   = cli__result_size(cmd->cmds);
+        max = (n > max)? n: max;
+    }
 
-                chr[0] = c = arg[i++];
-                chr[1] = 0;
+    return max;
+}
 
-                opt = cli__find_opt(&cmd, clip, clip->live, chr);
-                if (opt == NULL) {
-                    cli_bad_arg(
-                        out,
-                        clip->flags,
-                        1,
-                        "Invalid option:",
-                        chr
-                    );
-                    r = CLIP_ERR_BAD_ARG;
-                    goto done;
-                }
+size_t cli_result_size(const struct clip *clip)
+{
+    if (clip == NULL) {
+        return 0;
+    }
 
-                if (opt->mode == 0) {
-                    if ((r = clip->cb(clip, cmd, opt, NULL)) != 0) {
-                        r = CLIP_ERR_CB_FAIL;
-                        goto done;
-                    }
-                } else if ((opt->mode & ARG_REQD) != 0) {
-                    char *val = NULL;
-
-                    if (arg[i] == 0) {
-                        if (clip->index < argc) {
-                            i = 0;
-                            val = argv[clip->index++];
-                            arg = val;
-                        }
-                    } else {
-                        val = &arg[i];
-                    }
+    return cli__n_opts(clip->base) + cli__result_size(clip->cmds);
+}
 
-                    if (val == NULL) {
-                        cli_bad_arg(
-                            out,
-                            clip->flags,
-                            1,
-                            "Missing required value for",
-                            chr
-                        );
-                        r = CLIP_ERR_BAD_ARG;
-                        goto done;
-                    }
-                    len = strlen(val);
-                    i += len;
-                    if ((r = clip->cb(clip, cmd, opt, val)) != 0) {
-                        r = CLIP_ERR_CB_FAIL;
-                        goto done;
-                    }
-                }
-            } while (arg[i] != 0);
-        } else if (IS_LONG_OPT(arg)) {
-            char *key = &arg[2];
-            char *eq;
+const struct cli_seen *cli_get(
+    const struct cli_result *res,
+    const struct cli_opt *opt)
+{
+    size_t i;
 
-            if ((eq = strchr(key, '=')) != NULL) {
-                *eq = 0;
-            }
+    if (res == NULL || opt == NULL) {
+        return NULL;
+    }
 
-            opt = cli__find_opt(&cmd, clip, clip->live, key);
-            if (opt == NULL) {
-                cli_bad_arg(
-                    out,
-                    clip->flags,
-                    2,
-                    "Invalid option:",
-                    key
-                );
-                r = CLIP_ERR_BAD_ARG;
-                goto done;
-            }
+    i = cli__seen_at(res, opt);
+    return (i < res->n_all && res->seen[i].count > 0)? &res->seen[i]: NULL;
+}
 
-            if (opt->mode == 0) {
-                if ((r = clip->cb(clip, cmd, opt, NULL)) != 0) {
-                    r = CLIP_ERR_CB_FAIL;
-                    goto done;
-                }
-            } else if ((opt->mode & ARG_REQD) != 0) {
-                const char *val;
-
-                val = NULL;
-                if (eq != NULL) {
-                    val = eq + 1;
-                } else if (clip->index < argc) {
-                    val = argv[clip->index++];
-                }
+unsigned long cli_count(
+    const struct cli_result *res,
+    const struct cli_opt *opt)
+{
+    const struct cli_seen *seen;
 
-                if (val == NULL) {
-                    cli_bad_arg(
-                        out,
-                        clip->flags,
-                        2,
-                        "Missing required value for",
-                        key
-                    );
-                    r = CLIP_ERR_BAD_ARG;
-                    goto done;
-                }
+    seen = cli_get(res, opt);
+    return (seen != NULL)? seen->count: 0;
+}
 
-                if ((r = clip->cb(clip, cmd, opt, val)) != 0) {
-                    r = CLIP_ERR_CB_FAIL;
-                    return r;
-                }
-            }
-            if (eq) {
-                *eq = '='; /* Don't forget to restore it. */
-            }
+size_t cli_split(
+    const struct cli_opt *opt,
+    const char *value,
+    size_t len,
+    struct cli_elem *elems,
+    size_t n)
+{
+    const char *elem;
+    size_t at, e_len, count;
 
-        } else if (arg[0] == '@') {
-            /* Read arguments from file */
-            const char *name = &arg[1];
-            r = cli_do_file(clip, name, strlen(name));
-            if (r != 0) {
-                goto done;
-            }
-        } else if (IS_DOUBLE_DASH(arg)) {
-            goto done;
-        } else {
-            /* Any field? */
-            if ((opt = cli__find_any(clip->live)) == NULL) {
-                cli_bad_arg(
-                    out,
-                    clip->flags,
-                    0,
-                    "Unrecognised option:",
-                    arg
-                );
-                r = CLIP_ERR_BAD_ARG;
-                goto done;
-            }
+    if (opt == NULL || value == NULL || (opt->mode & ARG_LIST) == 0) {
+        return 0;
+    }
 
-            if ((r = clip->cb(clip, clip->live, opt, arg)) != 0) {
-                r = CLIP_ERR_CB_FAIL;
-                goto done;
-            }
+    at    = 0;
+    count = 0;
+    while ((e_len = cli__elem(OPT_SEP(opt), value, len, &at, &elem)) > 0) {
+        if (count < n) {
+            elems[count].str = elem;
+            elems[count].len = e_len;
         }
+        count++;
     }
 
-done:
-    return r;
+    return count;
 }
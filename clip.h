@@ -2,14 +2,113 @@
 #ifndef CLIP_H
 #define CLIP_H
 
+#include <limits.h>
 #include <stddef.h>
 
 #include <stdio.h>
 
+/**
+ * Longest line of an arguments file read a line at a time, with its end, see
+ * `clip::fbuf`.
+ */
 #ifndef CLIP_BUFFER_SIZE
 #define CLIP_BUFFER_SIZE                1024
 #endif
 
+/**
+ * Bytes of stack cli_summary() collects output in before writing it, with 0
+ * every piece is written to the `FILE` as it's made.
+ */
+#ifndef CLIP_SUMMARY_BUFFER
+#ifdef CLIP_PACKED
+#define CLIP_SUMMARY_BUFFER             0
+#else
+#define CLIP_SUMMARY_BUFFER             256
+#endif
+#endif
+
+/**
+ * Bytes of stack cli_parse() reads arguments files into a line at a time when
+ * `clip::fbuf` isn't given, with 0 an `@file` needs `clip::fbuf`.
+ */
+#ifndef CLIP_PARSE_BUFFER
+#ifdef CLIP_PACKED
+#define CLIP_PARSE_BUFFER               0
+#else
+#define CLIP_PARSE_BUFFER               CLIP_BUFFER_SIZE
+#endif
+#endif
+
+/**
+ * Maximum depth of arguments files including other arguments files.
+ */
+#ifndef CLIP_FILE_DEPTH
+#define CLIP_FILE_DEPTH                 4
+#endif
+
+/**
+ * Maximum number of distinct arguments files remembered during a parse.
+ */
+#ifndef CLIP_FILE_MAX
+#define CLIP_FILE_MAX                   4
+#endif
+
+/**
+ * Options of the base and of a sub-command that `cli_parse()` marks as given,
+ * see `clip_state::marks`. Those with attributes, see ::CLI_OPT_SWITCH_ATTR(),
+ * must be among the first this many of their sub-command.
+ */
+#ifndef CLIP_ATTR_MAX
+#ifdef CLIP_PACKED
+#define CLIP_ATTR_MAX                   64
+#else
+#define CLIP_ATTR_MAX                   256
+#endif
+#endif
+
+/**
+ * Number of groups of mutually exclusive options, see ::CLI_ATTR_GROUP(), at
+ * most 32.
+ */
+#ifndef CLIP_GROUP_MAX
+#define CLIP_GROUP_MAX                  16
+#endif
+
+/**
+ * Bytes of `clip_state::marks` for option tables of up to `_n` options.
+ */
+#define CLIP_MARKS(_n)                  (4 * (((_n) + 7) / 8))
+
+/**
+ * Number of options whose call-backs can be held until the end of a parse,
+ * see ::CLI_ATTR_LAST.
+ */
+#ifndef CLIP_HOLD_MAX
+#define CLIP_HOLD_MAX                   4
+#endif
+
+/**
+ * Maximum depth of nested sub-commands.
+ */
+#ifndef CLIP_CMD_DEPTH
+#define CLIP_CMD_DEPTH                  4
+#endif
+
+/**
+ * Most chunks an arguments file is split into, see `clip::par`.
+ */
+#ifndef CLIP_PAR_MAX
+#define CLIP_PAR_MAX                    8
+#endif
+
+/**
+ * Size in bytes from which arguments files are split, unless `clip::par_min`
+ * is set.
+ */
+#ifndef CLIP_PAR_MIN
+#define CLIP_PAR_MIN                    ((size_t)1 << 20)
+#endif
+
 /**
  * This is not an error as such, but a return code showing that the parser
  * encountered -h/--help or -v/--version on the command line.
@@ -41,6 +140,11 @@
  */
 #define CLIP_ERR_BAD_ARG                -4
 
+/**
+ * Not an error either, `cli_next()` has no more options to give.
+ */
+#define CLIP_ERR_END                     2
+
 /**
  * Provide -h/--help support automatically.
  */
@@ -57,12 +161,175 @@
  */
 #define CLIP_FLAG_USE_ANSI              ((unsigned)0x04)
 
+/**
+ * Look for -h/--help and -v/--version while parsing, instead of scanning all
+ * the arguments for them first. Call-backs for options appearing before
+ * either of them would have been invoked already.
+ */
+#define CLIP_FLAG_SINGLE_PASS           ((unsigned)0x08)
+
+/**
+ * Accept a unique prefix of a long option too, such as `--verb` for
+ * `--verbose`. A prefix that more than one option starts with is an error
+ * listing them all. With an index, see `cli_index_build()`, prefixes are
+ * binary searched.
+ */
+#define CLIP_FLAG_PREFIX                ((unsigned)0x10)
+
+/**
+ * Give positional arguments that follow one another in `argv` as one slice,
+ * see ::clap_cbs, and take all after `--` as positional instead of ending
+ * the parse there.
+ */
+#define CLIP_FLAG_SLICE                 ((unsigned)0x20)
+
+/**
+ * Answer `--clip-complete <index> <words...>` as the first argument, by
+ * printing to stdout what word `index` of `words` could be, for shell
+ * completion. Parsing then returns ::CLIP_ERR_HELP, before any call-back.
+ */
+#define CLIP_FLAG_COMPLETE              ((unsigned)0x40)
+
+/**
+ * Attribute of an option that must be given, in the sub-command it's defined
+ * in, or anywhere if it's a base option.
+ */
+#define CLI_ATTR_REQUIRED               ((unsigned)0x01)
+
+/**
+ * Attribute of an option that may be given only once.
+ */
+#define CLI_ATTR_ONCE                   ((unsigned)0x02)
+
+/**
+ * Attribute of an option whose call-back is invoked once, after all else is
+ * parsed, with only the last value it was given.
+ */
+#define CLI_ATTR_LAST                   ((unsigned)0x04)
+
+/**
+ * Same as ::CLI_ATTR_LAST, but with the first value given.
+ */
+#define CLI_ATTR_FIRST                  ((unsigned)0x08)
+
+/**
+ * Attribute of an option that can't be given along with any other option of
+ * the same group, `_id` being from 1 to `CLIP_GROUP_MAX - 1`.
+ */
+#define CLI_ATTR_GROUP(_id)             ((unsigned)(_id) << 8)
+
+/*
+ * Initializers of `struct cli_opt`, `struct cli_ext` and `struct cli_sub_cmd`
+ * in the order of their fields, see ::CLIP_PACKED. Options are counted from
+ * the array given, less the ::CLI_OPT_END() it still ends with.
+ */
+#define CLI__OPT(_short, _long, _tag, _mode, _help, _attr, _ext) \
+    { \
+        _short, (unsigned short)(_mode), (unsigned short)(_attr), \
+        _long, _tag, _help, _ext \
+    }
+
+#ifdef CLIP_PACKED
+#define CLI__EXT(_off, _min, _max, _env, _cb) \
+    { \
+        _env, _cb, (cli_range)(_min), (cli_range)(_max), \
+        (unsigned short)(_off) \
+    }
+
+/* A pointer for `_opts` can't be counted, so it doesn't build */
+#define CLI__CMD(_name, _opts, _cmds, _cb) \
+    { \
+        _name, _opts, _cmds, _cb, \
+        (unsigned short)(sizeof(_opts) / sizeof(struct cli_opt) - 1 + \
+            0 * sizeof(char[ \
+                (sizeof(_opts) % sizeof(struct cli_opt) == 0)? 1: -1])) \
+    }
+#else
+#define CLI__EXT(_off, _min, _max, _env, _cb) \
+    { _off, _min, _max, _env, _cb }
+
+#define CLI__CMD(_name, _opts, _cmds, _cb) \
+    { _name, _opts, _cmds, _cb }
+#endif
+
+/**
+ * \brief Define what an option takes from the environment and its handler,
+ * either may be NULL
+ * \hideinitializer
+ *
+ * \details
+ *  Few options have either, so they're kept apart from the options, in a
+ *  `struct cli_ext` of their own that the option points to:
+ *
+ *  ```c
+ *      static const struct cli_ext noop_ext = CLI_EXT_ENV("NOOP");
+ *
+ *      static struct cli_opt base_opts[] = {
+ *          CLI_OPT_SWITCH_ENV('n', "dry-run", "Do nothing", &noop_ext),
+ *          CLI_OPT_END()
+ *      };
+ *  ```
+ *
+ * \param _env
+ *      Name of the environment variable after `clip::env_prefix`, see
+ *      ::CLI_OPT_SWITCH_ENV()
+ * \param _cb
+ *      Handler of the option, see ::CLI_OPT_SWITCH_CB()
+ */
+#define CLI_EXT(_env, _cb) \
+    CLI__EXT(0, 0, 0, _env, _cb)
+
+/**
+ * \brief Same as ::CLI_EXT(), with only the name of an environment variable
+ * \hideinitializer
+ */
+#define CLI_EXT_ENV(_env) \
+    CLI__EXT(0, 0, 0, _env, NULL)
+
+/**
+ * \brief Same as ::CLI_EXT(), with only a handler
+ * \hideinitializer
+ */
+#define CLI_EXT_CB(_cb) \
+    CLI__EXT(0, 0, 0, NULL, _cb)
+
+/**
+ * \brief Define where a typed option is stored and the values it allows, see
+ * ::CLI_OPT_INT()
+ * \hideinitializer
+ *
+ * \param _type
+ *      Type of structure `clip->usr` points to
+ * \param _member
+ *      Member of `_type` to store the value in
+ * \param _min
+ *      Smallest value allowed
+ * \param _max
+ *      Largest value allowed. If not larger than `_min`, any value is allowed.
+ */
+#define CLI_EXT_TYPED(_type, _member, _min, _max) \
+    CLI__EXT(offsetof(_type, _member), _min, _max, NULL, NULL)
+
+/**
+ * \brief Define the bits a ::CLI_OPT_FLAG_SET() sets and where
+ * \hideinitializer
+ *
+ * \param _type
+ *      Type of structure `clip->usr` points to
+ * \param _member
+ *      Member of `_type`, an `unsigned`, to set the bits in
+ * \param _bits
+ *      Bits to set
+ */
+#define CLI_EXT_BITS(_type, _member, _bits) \
+    CLI__EXT(offsetof(_type, _member), 0, _bits, NULL, NULL)
+
 /**
  * \brief Define a generic command-line option
  * \hideinitializer
  */
 #define CLI_OPT_GENERIC(_short, _long, _tag, _mode, _help) \
-    { _short, _long, _tag, _mode, _help }
+    CLI__OPT(_short, _long, _tag, _mode, _help, 0, NULL)
 
 /**
  * \brief Define a switch option
@@ -82,7 +349,7 @@
  *      A brief help message describing the option
  */
 #define CLI_OPT_SWITCH(_short, _long, _help) \
-    { _short, _long, NULL, 0, _help }
+    CLI__OPT(_short, _long, NULL, 0, _help, 0, NULL)
 
 /**
  * \brief Define an option that also takes a value
@@ -98,7 +365,170 @@
  *      A brief help message describing the option
  */
 #define CLI_OPT_VALUE(_short, _long, _tag, _help) \
-    { _short, _long, _tag, ((unsigned)0x01), _help }
+    CLI__OPT(_short, _long, _tag, ((unsigned)0x01), _help, 0, NULL)
+
+/**
+ * \brief Same as ::CLI_OPT_SWITCH(), with attributes
+ * \hideinitializer
+ *
+ * \details
+ *  `_attr` is any of ::CLI_ATTR_REQUIRED, ::CLI_ATTR_ONCE,
+ *  ::CLI_ATTR_LAST or ::CLI_ATTR_FIRST and a ::CLI_ATTR_GROUP() OR-ed
+ *  together. They're checked as options are parsed, and for required
+ *  options, once all are.
+ */
+#define CLI_OPT_SWITCH_ATTR(_short, _long, _help, _attr) \
+    CLI__OPT(_short, _long, NULL, 0, _help, _attr, NULL)
+
+/**
+ * \brief Same as ::CLI_OPT_VALUE(), with attributes
+ * \hideinitializer
+ *
+ * \details
+ *  See ::CLI_OPT_SWITCH_ATTR().
+ */
+#define CLI_OPT_VALUE_ATTR(_short, _long, _tag, _help, _attr) \
+    CLI__OPT(_short, _long, _tag, ((unsigned)0x01), _help, _attr, NULL)
+
+/**
+ * \brief Same as ::CLI_OPT_SWITCH(), taken from a differently named
+ * environment variable
+ * \hideinitializer
+ *
+ * \details
+ *  `_ext` points to a ::CLI_EXT_ENV(), or ::CLI_EXT(), whose name follows
+ *  `clip::env_prefix`, instead of `_long` upper-cased.
+ */
+#define CLI_OPT_SWITCH_ENV(_short, _long, _help, _ext) \
+    CLI__OPT(_short, _long, NULL, 0, _help, 0, _ext)
+
+/**
+ * \brief Same as ::CLI_OPT_VALUE(), taken from a differently named
+ * environment variable
+ * \hideinitializer
+ *
+ * \details
+ *  See ::CLI_OPT_SWITCH_ENV().
+ */
+#define CLI_OPT_VALUE_ENV(_short, _long, _tag, _help, _ext) \
+    CLI__OPT(_short, _long, _tag, ((unsigned)0x01), _help, 0, _ext)
+
+/**
+ * \brief Same as ::CLI_OPT_SWITCH(), with a handler of its own
+ * \hideinitializer
+ *
+ * \details
+ *  `_ext` points to a ::CLI_EXT_CB(), or ::CLI_EXT(), whose ::clap_cbn is
+ *  invoked for the switch instead of the handler of the sub-command it
+ *  belongs to, or failing that the clip's own call-back.
+ */
+#define CLI_OPT_SWITCH_CB(_short, _long, _help, _ext) \
+    CLI__OPT(_short, _long, NULL, 0, _help, 0, _ext)
+
+/**
+ * \brief Same as ::CLI_OPT_VALUE(), with a handler of its own
+ * \hideinitializer
+ *
+ * \details
+ *  See ::CLI_OPT_SWITCH_CB().
+ */
+#define CLI_OPT_VALUE_CB(_short, _long, _tag, _help, _ext) \
+    CLI__OPT(_short, _long, _tag, ((unsigned)0x01), _help, 0, _ext)
+
+/**
+ * \brief Define an option whose value is a list
+ * \hideinitializer
+ *
+ * \details
+ *  The value is split at each `_sep`, a single character such as `','` or
+ *  `':'`, and the call-back is invoked once for each element that isn't
+ *  empty, so `--peer=a,b,c` gives `a`, `b` and `c`. A ::clap_cbn is given
+ *  each element where it is in the argument or arguments file, with nothing
+ *  copied or written, for ::clap_cb it's copied into the room left in
+ *  `clip::fbuf` to be NUL terminated, so it must be larger than
+ *  ::CLIP_BUFFER_SIZE. Tokens of `cli_next()` hold the whole value, see
+ *  `cli_split()`.
+ *
+ * \param _short
+ *      Short, single character option
+ * \param _long
+ *      Long string like option
+ * \param _tag
+ *      Single word tag naming the value
+ * \param _help
+ *      A brief help message describing the option
+ * \param _sep
+ *      Character between the elements
+ */
+#define CLI_OPT_LIST(_short, _long, _tag, _help, _sep) \
+    CLI__OPT( \
+        _short, _long, _tag, \
+        ((unsigned)0x05 | (unsigned)(unsigned char)(_sep) << 8), _help, 0, \
+        NULL \
+    )
+
+/**
+ * \brief Define an option whose value is stored as a `long`
+ * \hideinitializer
+ *
+ * \details
+ *  No call-back is invoked for typed options, the value is converted and
+ *  stored where `_ext` says, in the structure `clip->usr` points to. The
+ *  value is decimal, or hexadecimal if prefixed by `0x`, and may be signed.
+ *
+ *  ```c
+ *      static const struct cli_ext port_ext =
+ *          CLI_EXT_TYPED(struct config, port, 1, 65535);
+ *  ```
+ *
+ * \param _short
+ *      Short, single character option
+ * \param _long
+ *      Long string like option
+ * \param _tag
+ *      Single word tag naming the value
+ * \param _help
+ *      A brief help message describing the option
+ * \param _ext
+ *      Where to store the value and its range, see ::CLI_EXT_TYPED()
+ */
+#define CLI_OPT_INT(_short, _long, _tag, _help, _ext) \
+    CLI__OPT(_short, _long, _tag, ((unsigned)0x11), _help, 0, _ext)
+
+/**
+ * \brief Define an option whose value is stored as a `size_t`
+ * \hideinitializer
+ *
+ * \details
+ *  Same as ::CLI_OPT_INT, except the value is unsigned and may be followed by
+ *  `k`, `M` or `G` to multiply it by 1024, 1024^2 or 1024^3.
+ */
+#define CLI_OPT_SIZE(_short, _long, _tag, _help, _ext) \
+    CLI__OPT(_short, _long, _tag, ((unsigned)0x21), _help, 0, _ext)
+
+/**
+ * \brief Define an option whose value is stored as milliseconds
+ * \hideinitializer
+ *
+ * \details
+ *  Same as ::CLI_OPT_INT, except the value is unsigned, stored as an
+ *  `unsigned long` number of milliseconds and may be followed by a unit of
+ *  `ms`, `s`, `m`, `h` or `d`. Without a unit, the value is in seconds.
+ *  The range of ::CLI_EXT_TYPED() is in milliseconds.
+ */
+#define CLI_OPT_DURATION(_short, _long, _tag, _help, _ext) \
+    CLI__OPT(_short, _long, _tag, ((unsigned)0x31), _help, 0, _ext)
+
+/**
+ * \brief Define a switch that sets bits of an `unsigned`
+ * \hideinitializer
+ *
+ * \details
+ *  No call-back is invoked, each time the switch appears the bits of `_ext`
+ *  are set, see ::CLI_EXT_BITS().
+ */
+#define CLI_OPT_FLAG_SET(_short, _long, _help, _ext) \
+    CLI__OPT(_short, _long, NULL, ((unsigned)0x40), _help, 0, _ext)
 
 /**
  * \brief Final list of arguments usually to capture a list of files
@@ -118,14 +548,25 @@
  *      A brief help message describing the option
  */
 #define CLI_OPT_NARGS(_tag, _help) \
-    { 0, NULL, _tag, ((unsigned)0x02), _help }
+    CLI__OPT(0, NULL, _tag, ((unsigned)0x02), _help, 0, NULL)
+
+/**
+ * \brief Same as ::CLI_OPT_NARGS(), with a handler of its own
+ * \hideinitializer
+ *
+ * \details
+ *  The handler of `_ext` is invoked once for each argument, even with
+ *  ::CLIP_FLAG_SLICE. See ::CLI_OPT_SWITCH_CB().
+ */
+#define CLI_OPT_NARGS_CB(_tag, _help, _ext) \
+    CLI__OPT(0, NULL, _tag, ((unsigned)0x02), _help, 0, _ext)
 
 /**
  * \brief Mark the end of options list
  * \hideinitializer
  */
 #define CLI_OPT_END() \
-    { 0, NULL, NULL, 0, NULL }
+    CLI__OPT(0, NULL, NULL, 0, NULL, 0, NULL)
 
 /**
  * \brief Add a sub-command to the list
@@ -137,13 +578,65 @@
  *      Pointer to struct cli_opt that belongs to this sub-command.
  */
 #define CLI_CMD(_name, _opts) \
-    { _name, _opts }
+    CLI__CMD(_name, _opts, NULL, NULL)
+
+/**
+ * \brief Add a sub-command that has its own sub-commands
+ * \hideinitializer
+ *
+ * \details
+ *  Nested sub-commands appear on the command-line right after their parent,
+ *  for example `myprog remote add`.
+ *
+ * \param _name
+ *      Name of the sub-command.
+ * \param _opts
+ *      Pointer to struct cli_opt that belongs to this sub-command or NULL,
+ *      unless built with `CLIP_PACKED`.
+ * \param _cmds
+ *      A ::CLI_CMD_END terminated list of nested sub-commands.
+ */
+#define CLI_CMD_NESTED(_name, _opts, _cmds) \
+    CLI__CMD(_name, _opts, _cmds, NULL)
+
+/**
+ * \brief Same as ::CLI_CMD(), with a handler for its options
+ * \hideinitializer
+ *
+ * \details
+ *  `_cb` is a ::clap_cbn invoked for the options of the sub-command that have
+ *  no handler of their own, instead of the clip's call-back. Options of the
+ *  base that are given after the sub-command go to the handler of the base.
+ *
+ * \param _name
+ *      Name of the sub-command. Set this to NULL for default sub-command.
+ * \param _opts
+ *      Pointer to struct cli_opt that belongs to this sub-command.
+ * \param _cb
+ *      Handler of the options
+ */
+#define CLI_CMD_CB(_name, _opts, _cb) \
+    CLI__CMD(_name, _opts, NULL, _cb)
+
+/**
+ * \brief Same as ::CLI_CMD_NESTED(), with a handler for its options
+ * \hideinitializer
+ *
+ * \details
+ *  See ::CLI_CMD_CB().
+ */
+#define CLI_CMD_NESTED_CB(_name, _opts, _cmds, _cb) \
+    CLI__CMD(_name, _opts, _cmds, _cb)
 
 /**
  * \brief Mark the end of sub-commands-list
  * \hideinitializer
  */
-#define CLI_CMD_END()                   CLI_CMD(NULL, NULL)
+#ifdef CLIP_PACKED
+#define CLI_CMD_END()                   { NULL, NULL, NULL, NULL, 0 }
+#else
+#define CLI_CMD_END()                   { NULL, NULL, NULL, NULL }
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -152,6 +645,7 @@ extern "C" {
 struct cli_opt;
 struct cli_sub_cmd;
 struct clip;
+struct clip_state;
 
 /**
  * \brief Call back function that will be invoked for every option
@@ -174,29 +668,615 @@ typedef int (*clap_cb)(
 );
 
 /**
- * \brief A single command-line option definition
+ * \brief Call back function that's also given the length of value
  *
- * \note Use `CLI_OPT_*` macros to define options
+ * \details
+ *  Same as ::clap_cb, except that `value` need not be NUL terminated. This
+ *  lets values be passed straight out of a mapped or buffered arguments file
+ *  without copying them. It's given the state of the parse it's invoked for,
+ *  so the same definition can be used by parses running at the same time.
+ *
+ * \param st
+ *      The parse state, `st->clip` is the Command Line Parser context and
+ *      `st->usr` the user defined pointer for this parse
+ * \param cmd
+ *      The sub-command object or the default/global command object in which the
+ *      option appears
+ * \param arg
+ *      The command line option. NULL if this is a call-back for sub-command
+ * \param value
+ *      The option's value if any or NULL
+ * \param len
+ *      Length of `value` in bytes
  */
-struct cli_opt {
-    int a_short;
-    const char *a_long;
-    const char *tag;
-    unsigned mode;
-    const char *help;
-};
+typedef int (*clap_cbn)(
+    const struct clip_state *st,
+    const struct cli_sub_cmd *cmd,
+    const struct cli_opt *arg,
+    const char *value,
+    size_t len
+);
 
 /**
- * \brief A single sub-command
+ * \brief Call back function for a slice of positional arguments
  *
- * \details Represents both the default options grouping or groupings for a
- * specific sub-command.
+ * \details
+ *  With ::CLIP_FLAG_SLICE, positional arguments that follow one another in
+ *  `argv` are given to this in one call, instead of one call each to
+ *  ::clap_cb or ::clap_cbn.
  *
- * \note Use `CLI_CMD*` macros to define a sub-command.
+ * \param st
+ *      The parse state, as for ::clap_cbn
+ * \param cmd
+ *      The sub-command object or the default/global command object in which the
+ *      option appears
+ * \param arg
+ *      The ::CLI_OPT_NARGS() option of `cmd`
+ * \param args
+ *      The first of the arguments, pointing into `argv`
+ * \param n
+ *      Number of arguments from `args`
+ */
+typedef int (*clap_cbs)(
+    const struct clip_state *st,
+    const struct cli_sub_cmd *cmd,
+    const struct cli_opt *arg,
+    const char *const *args,
+    size_t n
+);
+
+/**
+ * \brief Runs the chunks of a large arguments file, see `clip::par`
+ *
+ * \details
+ *  Each `work(job, i)`, for `i` from 0 to `n - 1`, may be run on a thread of
+ *  its own and in any order. They only read the parse state and the option
+ *  tables, and each writes to a part of `clip_state::toks` of its own.
+ *
+ * \param clap
+ *      The Command Line Parser context
+ * \param work
+ *      What to run for each chunk
+ * \param job
+ *      The chunks, passed on to `work`
+ * \param n
+ *      Number of chunks
+ *
+ * \returns 0
+ *      Once every `work` has returned
+ * \returns Anything else
+ *      If they couldn't be run, the file is then read on the calling thread
+ */
+typedef int (*clap_par)(
+    const struct clip *clap,
+    void (*work)(void *job, int i),
+    void *job,
+    int n
+);
+
+/**
+ * \brief What few options have, kept apart from `struct cli_opt`
+ *
+ * \note Use `CLI_EXT*` macros to define one
+ */
+#ifdef CLIP_PACKED
+/*
+ * Built with `CLIP_PACKED`, fields are narrowed and ordered to leave as little
+ * padding as can be, and sub-commands count their options rather than look
+ * for the ::CLI_OPT_END() at the end. Offsets of typed options are then at
+ * most 65535, ranges of typed options are 32 bits, and sub-commands can only
+ * be defined with the `CLI_CMD*` macros.
+ */
+#if INT_MAX >= 2147483647
+typedef int cli_range;
+#else
+typedef long cli_range;
+#endif
+
+struct cli_ext {
+    const char *env;
+    clap_cbn cb;
+    cli_range min;
+    cli_range max;
+    unsigned short off;
+};
+#else
+struct cli_ext {
+    /**
+     * Typed options only, offset of the value in `clip->usr`
+     */
+    size_t off;
+
+    /**
+     * Typed options only, range of values allowed. Flags options set the bits
+     * in `max`.
+     */
+    long min;
+    long max;
+
+    /**
+     * Environment variable name, see ::CLI_OPT_SWITCH_ENV()
+     */
+    const char *env;
+
+    /**
+     * Handler of the option or NULL, see ::CLI_OPT_SWITCH_CB()
+     */
+    clap_cbn cb;
+};
+#endif
+
+/**
+ * \brief A single command-line option definition
+ *
+ * \note Use `CLI_OPT_*` macros to define options
+ */
+struct cli_opt {
+    int a_short;
+
+    /**
+     * Kind of value, and the separator of a ::CLI_OPT_LIST() above the low 8
+     * bits
+     */
+    unsigned short mode;
+
+    /**
+     * Attributes, see ::CLI_OPT_SWITCH_ATTR()
+     */
+    unsigned short attr;
+
+    const char *a_long;
+    const char *tag;
+    const char *help;
+
+    /**
+     * Where typed options are stored, the environment variable and handler,
+     * or NULL, see `struct cli_ext`
+     */
+    const struct cli_ext *ext;
+};
+
+/**
+ * \brief A single sub-command
+ *
+ * \details Represents both the default options grouping or groupings for a
+ * specific sub-command.
+ *
+ * \note Use `CLI_CMD*` macros to define a sub-command.
  */
 struct cli_sub_cmd {
     const char *name;
     const struct cli_opt *opts;
+    const struct cli_sub_cmd *cmds;
+
+    /**
+     * Handler of the options or NULL, see ::CLI_CMD_CB()
+     */
+    clap_cbn cb;
+#ifdef CLIP_PACKED
+    unsigned short n_opts;
+#endif
+};
+
+/**
+ * \brief A long option name along with its length
+ *
+ * \note Storage for these is provided by the caller to `cli_index_build()`.
+ */
+struct cli_key {
+    const char *name;
+    size_t len;
+    const struct cli_opt *opt;
+};
+
+struct cli_index;
+
+/**
+ * \brief Finds a long option of `len` bytes in an index, see `cli_index::find`
+ */
+typedef const struct cli_opt *(*cli_find)(
+    const struct cli_index *idx,
+    const char *name,
+    size_t len
+);
+
+/**
+ * \brief Pre-computed option lookup tables for a single sub-command
+ *
+ * \details
+ *  Short options are looked up directly in `shorts` while long options are
+ *  binary searched in `keys`, which is kept sorted by name. Use
+ *  `cli_index_build()` to fill this structure.
+ *
+ *  If `find` is set, long options are looked up by it instead, and `keys`
+ *  only used to find prefixes. `clip.hpp` sets it to a perfect hash of the
+ *  names built at compile time.
+ *
+ *  Options that name an environment variable of their own are binary
+ *  searched by that name in `envs`, sorted the same way.
+ */
+struct cli_index {
+    const struct cli_sub_cmd *cmd;
+    const struct cli_opt *shorts[256];
+    const struct cli_key *keys;
+    size_t n_keys;
+    cli_find find;
+    const struct cli_key *envs;
+    size_t n_envs;
+};
+
+/**
+ * \brief A sub-command name along with its length
+ *
+ * \details
+ *  Sub-commands sharing the same parent are stored next to each other, sorted
+ *  by name. `sub` and `n_sub` locate the run of nested sub-commands of `cmd`.
+ *
+ * \note Storage for these is provided by the caller to
+ * `cli_cmd_index_build()`.
+ */
+struct cli_cmd_key {
+    const char *name;
+    size_t len;
+    const struct cli_sub_cmd *cmd;
+    size_t sub;
+    size_t n_sub;
+};
+
+/**
+ * \brief Pre-computed sub-command lookup table
+ *
+ * \details
+ *  The first `n_top` keys are the top-level sub-commands, i.e. those in
+ *  `clip->cmds`. Use `cli_cmd_index_build()` to fill this structure.
+ */
+struct cli_cmd_index {
+    const struct cli_sub_cmd *cmds;
+    const struct cli_cmd_key *keys;
+    size_t n_keys;
+    size_t n_top;
+};
+
+/**
+ * \brief A single option as it was parsed
+ *
+ * \details
+ *  `opt` is the option found in `cmd` with its `value`, if any, of `len` bytes.
+ *  `index` is the position in arguments vector it came from. If `opt` and
+ *  `cmd` are both NULL, this refers to the arguments file named by `value`.
+ *  With ::CLIP_FLAG_SLICE, a token of a ::CLI_OPT_NARGS() option with NULL
+ *  `value` is `len` positional arguments from `argv[index]`.
+ */
+struct cli_token {
+    const struct cli_opt *opt;
+    const struct cli_sub_cmd *cmd;
+    const char *value;
+    size_t len;
+    int index;
+};
+
+/**
+ * \brief An element of the value of a list option, see `cli_split()`
+ */
+struct cli_elem {
+    const char *str;
+    size_t len;
+};
+
+/**
+ * \brief What was given of one option, see `cli_get()`
+ */
+struct cli_seen {
+    /**
+     * Number of times the option was given, 0 if it wasn't
+     */
+    unsigned long count;
+
+    /**
+     * Index in the arguments vector it was first given at
+     */
+    int index;
+
+    /**
+     * The last value given, NUL terminated in `cli_result::buf`, or NULL
+     */
+    const char *value;
+    size_t len;
+};
+
+/**
+ * \brief Options given to a parse, for after it's over
+ *
+ * \details
+ *  Storage is all provided by the caller. Every option given to call-backs,
+ *  or that would be, has an entry in `seen` for its own table or the base's,
+ *  and its values are copied to `buf`. Positional arguments are also listed
+ *  in `args`. Nothing then points into `argv` or the arguments files, so the
+ *  result can be handed to other threads or kept across `fork()`.
+ */
+struct cli_result {
+    /**
+     * An entry for each option of a sub-command and the base, see
+     * `cli_result_size()`
+     */
+    struct cli_seen *seen;
+    size_t n_seen;
+
+    /**
+     * Where positional arguments are listed, `a_used` of them once parsed
+     */
+    const char **args;
+    size_t n_args;
+
+    /**
+     * Where values are copied to
+     */
+    char *buf;
+    size_t buf_len;
+
+    /* PRIVATE or RETURN FIELDS */
+
+    const struct cli_sub_cmd *cmd;
+    const struct cli_sub_cmd *base;
+    size_t n_cmd;
+    size_t n_all;
+    size_t a_used;
+    size_t b_used;
+};
+
+#ifdef CLIP_STATS
+/**
+ * \brief What parsing cost, counted when built with `CLIP_STATS` defined
+ *
+ * \details
+ *  Counters are only ever added to, so zero them between parses to see each
+ *  on its own. The hooks, if set, are invoked right before and after each
+ *  call-back with the token it's given, `r` being what the call-back
+ *  returned. With `CLIP_STATS` not defined, none of this is built in.
+ */
+struct clip_stats {
+    /**
+     * Options and sub-commands given out, from arguments or files
+     */
+    unsigned long tokens;
+
+    /**
+     * Entries of option tables, indices and sub-command lists compared
+     */
+    unsigned long compares;
+
+    /**
+     * Calls to `strlen()` made to match arguments
+     */
+    unsigned long strlens;
+
+    /**
+     * Call-backs invoked for options, and typed options stored
+     */
+    unsigned long calls;
+
+    /**
+     * Bytes read, or mapped, from arguments files
+     */
+    unsigned long file_bytes;
+
+    /**
+     * Optional hook invoked before each call-back
+     */
+    void (*cb_begin)(const struct clip_state *st, const struct cli_token *tok);
+
+    /**
+     * Optional hook invoked after each call-back
+     */
+    void (*cb_end)(
+        const struct clip_state *st,
+        const struct cli_token *tok,
+        int r
+    );
+};
+#endif
+
+/**
+ * \internal
+ * \brief An arguments file read during parsing
+ */
+struct cli_file {
+    const char *name;
+    size_t len;
+    size_t tok;
+    size_t n_tok;
+#ifdef CLIP_USE_MMAP
+    void *map;
+    size_t map_len;
+#endif
+};
+
+/**
+ * \internal
+ * Value of `cli_file::n_tok` if the file's tokens weren't recorded.
+ */
+#define CLIP_NO_TOKENS                  ((size_t)-1)
+
+/**
+ * \internal
+ * \brief An arguments file being read, or replayed, by `cli_next()`
+ */
+struct cli_src {
+    const char *name;
+    size_t len;
+    unsigned long hash;
+    unsigned char kind;
+    unsigned char term;
+    unsigned char tail;
+    unsigned char skip;
+    char *p;
+    char *end;
+    FILE *f;
+    struct cli_file *ent;
+    size_t tok;
+    size_t next;
+    size_t last;
+    size_t used;
+#ifdef CLIP_USE_MMAP
+    void *map;
+    size_t map_len;
+    FILE *cache;
+    unsigned long c_key;
+    unsigned long c_n;
+    unsigned long c_bytes;
+    int c_seq;
+#endif
+};
+
+/**
+ * \brief State of a single parse
+ *
+ * \details
+ *  Everything that changes while parsing is kept here, the definition in
+ *  `struct clip` is only read. One definition can then be used by any number
+ *  of parses at the same time, each with its own state. Use
+ *  `cli_state_init()` before anything else.
+ */
+struct clip_state {
+    /**
+     * The definition being parsed against
+     */
+    const struct clip *clip;
+
+    /**
+     * User defined pointer for this parse, typed options are stored here
+     */
+    void *usr;
+
+    /**
+     * Optional buffer to read arguments files into, see `clip::fbuf`
+     */
+    char *fbuf;
+
+    /**
+     * Size of `fbuf` in bytes
+     */
+    size_t fbuf_len;
+
+    /**
+     * Optional storage to record arguments files in, see `clip::toks`
+     */
+    struct cli_token *toks;
+
+    /**
+     * Number of entries in `toks`
+     */
+    size_t n_toks;
+
+    /**
+     * Where the options given are kept, see `clip::result`
+     */
+    struct cli_result *result;
+
+    /**
+     * Arguments files being read, one for each file included by another
+     *
+     * Without any, no arguments file can be read. `cli_parse()` gives
+     * ::CLIP_FILE_DEPTH of them. Their size, as that of `files`, depends on
+     * `CLIP_USE_MMAP`, so it must be the same here as for clip.c.
+     */
+    struct cli_src *srcs;
+
+    /**
+     * Number of entries in `srcs`
+     */
+    int n_srcs;
+
+    /**
+     * Optional storage to remember the arguments files read in
+     *
+     * Only remembered files can be replayed from `toks`, or stay mapped until
+     * parsing is over. `cli_parse()` gives ::CLIP_FILE_MAX of them.
+     */
+    struct cli_file *files;
+
+    /**
+     * Number of entries in `files`
+     */
+    size_t n_files;
+
+    /**
+     * Optional storage to hold options in until the end of a parse, see
+     * ::CLI_ATTR_LAST
+     *
+     * Once it's full, an option with ::CLI_ATTR_FIRST is invoked as it's
+     * given, and one with ::CLI_ATTR_LAST fails. `cli_parse()` gives
+     * ::CLIP_HOLD_MAX of them.
+     */
+    struct cli_token *hold;
+
+    /**
+     * Number of entries in `hold`
+     */
+    size_t n_hold;
+
+    /**
+     * Optional storage to mark the options given in, ::CLIP_MARKS() bytes for
+     * the largest of the base and the sub-command parsed
+     *
+     * Without room to mark it, an option with attributes fails the parse.
+     * `cli_parse()` gives `CLIP_MARKS(CLIP_ATTR_MAX)` bytes.
+     */
+    unsigned char *marks;
+
+    /**
+     * Size of `marks` in bytes
+     */
+    size_t n_marks;
+
+#ifdef CLIP_STATS
+    /**
+     * Where this parse is counted, see `clip::stats`
+     */
+    struct clip_stats *stats;
+#endif
+
+    /* PRIVATE or RETURN FIELDS */
+
+    int index;
+    int depth;
+    const struct cli_sub_cmd *live;
+    const struct cli_index *l_idx;
+    const struct cli_index *b_idx;
+    const struct cli_sub_cmd *trail[CLIP_CMD_DEPTH];
+    size_t f_n;
+    int f_depth;
+    int f_rec;
+    size_t f_used;
+    size_t f_top;
+    size_t n_rec;
+    size_t s_next;
+    char *line;
+    size_t line_len;
+    int argc;
+    int p_short;
+    const char *const *argv;
+    const char *w_next;
+    const struct cli_sub_cmd *c_cmds;
+    const struct cli_cmd_key *c_keys;
+    size_t c_n;
+    int feed;
+    int dashed;
+    const struct cli_opt *p_opt;
+    const struct cli_sub_cmd *p_cmd;
+    size_t m_bytes;
+    unsigned long g_seen;
+    char **e_pos;
+    size_t h_n;
+    const struct cli_opt *any;
+    const struct cli_sub_cmd *any_cmd;
+    const char *arg;
+    int a_pos;
+    int a_index;
+    int c_next;
+    unsigned autos;
+    int done;
+    int v_tmp;
 };
 
 /**
@@ -229,80 +1309,233 @@ struct cli_sub_cmd {
  */
 struct clip {
     /**
-     * User defined pointer, it can point to anything
+     * User defined pointer, it can point to anything
+     */
+    void *usr;
+
+    /**
+     * Use ANSI codes to display
+     *
+     * Instead of blindly setting this, one possible way to set this would be
+     * as:
+     *
+     *    clap.use_ansi = isatty(fileno(clap.f_out));
+     */
+    unsigned flags;
+
+    /**
+     * Name of the program
+     *
+     * \note GNU prefers that you explicitly state the program name as argv[0]
+     * is usually unreliable.
+     */
+    const char *progname;
+
+    /**
+     * Small, one line description of the program
+     */
+    const char *header;
+
+    /**
+     * Copyrights and licenses if any
+     */
+    const char *footer;
+
+    /**
+     * Optional version of the program
+     */
+    const char *version;
+
+    /**
+     * Global/default options
+     *
+     * In small programs where there aren't any sub-commands, this is the only
+     * set of options defined.
+     */
+    const struct cli_sub_cmd *base;
+
+    /**
+     * A ::CLI_CMD_END terminated list of sub-commands
+     */
+    const struct cli_sub_cmd *cmds;
+
+    /**
+     * Callback function to be invoked for each option
+     *
+     * \note this function is invoked for the sub-command as well as for each
+     * option
+     */
+    clap_cb cb;
+
+    /**
+     * Optional call-back function that's also given length of values
+     *
+     * \note If set, this is invoked instead of `cb`
+     */
+    clap_cbn cbn;
+
+    /**
+     * Optional call-back function for slices of positional arguments
+     *
+     * \note Only with ::CLIP_FLAG_SLICE, if not set the options of a slice are
+     * given to `cbn` or `cb` one at a time
+     */
+    clap_cbs cbs;
+
+    /**
+     * The place where help, error messages, etc. will be printed.
+     */
+    FILE *out;
+
+    /**
+     * Optional list of pre-built option indices, one per sub-command
+     *
+     * If a sub-command (or `base`) has no index in this list, its options are
+     * searched linearly. See `cli_index_build()`.
+     */
+    const struct cli_index *idx;
+
+    /**
+     * Number of entries in `idx`
+     */
+    size_t n_idx;
+
+    /**
+     * Optional pre-built sub-command index, see `cli_cmd_index_build()`
      */
-    void *usr;
+    const struct cli_cmd_index *cmd_idx;
 
     /**
-     * Use ANSI codes to display
+     * Optional buffer to read an entire arguments file into
      *
-     * Instead of blindly setting this, one possible way to set this would be
-     * as:
+     * Lines are then split with no copying. Files that don't fit are read a
+     * line at a time, into the last ::CLIP_BUFFER_SIZE bytes of it, or all of
+     * it if it's smaller, which entire files aren't read into. When built
+     * with `CLIP_USE_MMAP`, arguments files are memory mapped instead, if
+     * possible.
      *
-     *    clap.use_ansi = isatty(fileno(clap.f_out));
+     * Without one, `cli_parse()` reads lines into a buffer of its own on the
+     * stack, of ::CLIP_PARSE_BUFFER bytes, while parses with a
+     * `struct clip_state` can't read arguments files and `cli_feed_begin()`
+     * fails.
      */
-    unsigned flags;
+    char *fbuf;
 
     /**
-     * Name of the program
+     * Size of `fbuf` in bytes
+     */
+    size_t fbuf_len;
+
+    /**
+     * Optional storage to record options read from arguments files
      *
-     * \note GNU prefers that you explicitly state the program name as argv[0]
-     * is usually unreliable.
+     * An arguments file may include another by a line `@other.txt`. If the
+     * same file is included more than once, its recorded options are replayed
+     * instead of reading it again. Only files read entirely into `fbuf` or
+     * mapped can be recorded.
      */
-    const char *progname;
+    struct cli_token *toks;
 
     /**
-     * Small, one line description of the program
+     * Number of entries in `toks`
      */
-    const char *header;
+    size_t n_toks;
 
     /**
-     * Copyrights and licenses if any
+     * Columns that help is wrapped to, or 0 to take `COLUMNS` from the
+     * environment, if set, else 80
+     *
+     * From 100 on, help for each option is given beside it instead of below.
      */
-    const char *footer;
+    unsigned width;
 
     /**
-     * Optional version of the program
+     * Optional prefix of environment variables that options are taken from
+     *
+     * An option `--dry-run` is taken from `<prefix>DRY_RUN`, unless it names
+     * a variable of its own. These come after all the arguments, and only
+     * for options that the arguments files and the command line didn't give.
+     * A variable for an option past what `clip_state::marks` has room for
+     * fails the parse. Switches are given if the variable is set to anything
+     * other than empty or `0`.
      */
-    const char *version;
+    const char *env_prefix;
 
     /**
-     * Global/default options
+     * Environment to look for `env_prefix` in, such as `environ` or the third
+     * argument of `main()`
+     */
+    char **envp;
+
+    /**
+     * Optional hook to look up the options of large arguments files on many
+     * threads
      *
-     * In small programs where there aren't any sub-commands, this is the only
-     * set of options defined.
+     * A file read entirely into `fbuf`, or mapped, of at least `par_min`
+     * bytes is split at line ends into `par_n` chunks, whose options are
+     * stored in `toks` as they're found. Call-backs are still invoked in
+     * order, on the calling thread. If a chunk has more lines than its share
+     * of what's left of `toks`, the file is read on the calling thread.
      */
-    const struct cli_sub_cmd *base;
+    clap_par par;
 
     /**
-     * A ::CLI_CMD_END terminated list of sub-commands
+     * Number of chunks a file is split into, at most ::CLIP_PAR_MAX
      */
-    const struct cli_sub_cmd *cmds;
+    int par_n;
 
     /**
-     * Callback function to be invoked for each option
+     * Size in bytes from which files are split, or 0 for ::CLIP_PAR_MIN
+     */
+    size_t par_min;
+
+    /**
+     * Optional directory to cache arguments files in, only when built with
+     * `CLIP_USE_MMAP`
      *
-     * \note this function is invoked for the sub-command as well as for each
-     * option
+     * Options are written there as they're read from a file. When the same
+     * file is included again, by this or any later parse, the cache is mapped
+     * instead, with nothing left to split or look up. It's used only while
+     * the file has the same device, inode, size and modification time, and
+     * the options defined are the same. Files that include others, or that
+     * were changed within the last second, aren't cached.
      */
-    clap_cb cb;
+    const char *cache_dir;
 
     /**
-     * The place where help, error messages, etc. will be printed.
+     * Optional result to keep the options given in, as well as invoking any
+     * call-backs
+     *
+     * It's emptied as each parse begins, and the options given are then
+     * looked up with `cli_get()` and `cli_count()`. With a result, options
+     * need no call-back. Copied into each `struct clip_state`, so parses
+     * running at the same time should each be given their own.
      */
-    FILE *out;
+    struct cli_result *result;
+
+#ifdef CLIP_STATS
+    /**
+     * Optional counters and hooks, only with `CLIP_STATS` defined
+     *
+     * Copied into each `struct clip_state`, so parses running at the same
+     * time should each be given their own.
+     */
+    struct clip_stats *stats;
+#endif
 
     /* PRIVATE or RETURN FIELDS */
 
     int index;
-    const struct cli_sub_cmd *live;
 };
 
 /**
  * \brief Display a summary of options on a specific sub-command.
  *
  * \details
- *  The summary is printed to `
+ *  The summary is printed to `clap->out`, or stdout if that's NULL, in
+ *  writes of ::CLIP_SUMMARY_BUFFER bytes at a time. `clap->fbuf` isn't used,
+ *  as it may be in use by the parse of a call-back this is invoked from, see
+ *  `cli_summary_buf()` to render it in one go.
  *  If the `cmd` is passed as NULL, then it picks `clap->base` as default and
  *  attempts to print a summary of it. If `clap->flags` specifies
  *  `::CLIP_FLAG_USE_ANSI`, then some ANSI escape sequences will be used to
@@ -319,7 +1552,42 @@ struct clip {
  * \returns CLIP_ERR_INVALID
  *      If `clap` is NULL
  */
-int cli_summary(struct clip *clap, const struct cli_sub_cmd *cmd);
+int cli_summary(const struct clip *clap, const struct cli_sub_cmd *cmd);
+
+/**
+ * \brief Render the summary that `cli_summary()` prints into a buffer
+ *
+ * \details
+ *  The summary is written to `buf` and NUL terminated, as much of it as fits
+ *  in `size` bytes. `len` is set to the length of the whole summary, so if
+ *  it isn't less than `size`, the summary was cut short. With `buf` NULL and
+ *  `size` 0, only its length is worked out. The summary doesn't change
+ *  between parses, so it can be rendered once and written out in one go
+ *  whenever it's asked for.
+ *
+ * \param clap
+ *      The command-line parser context
+ * \param cmd
+ *      Optional sub-command, as for `cli_summary()`
+ * \param buf
+ *      Where the summary is written to
+ * \param size
+ *      Size of `buf` in bytes
+ * \param len
+ *      Optional, set to the length of the whole summary
+ *
+ * \returns 0
+ *      On success
+ * \returns CLIP_ERR_INVALID
+ *      If `clap` is NULL, or `buf` is NULL with a `size`
+ */
+int cli_summary_buf(
+    const struct clip *clap,
+    const struct cli_sub_cmd *cmd,
+    char *buf,
+    size_t size,
+    size_t *len
+);
 
 /**
  * \def cli_verify
@@ -334,6 +1602,101 @@ int cli_summary(struct clip *clap, const struct cli_sub_cmd *cmd);
  */
 void cli_verify(struct clip *clap);
 
+/**
+ * \brief Number of `struct cli_key` entries needed to index a sub-command
+ *
+ * \param cmd
+ *      The sub-command or default options to be indexed
+ *
+ * \returns
+ *      Count of long options in `cmd`, and of those that name an environment
+ *      variable
+ */
+size_t cli_index_keys(const struct cli_sub_cmd *cmd);
+
+/**
+ * \brief Build an option lookup index for a sub-command
+ *
+ * \details
+ *  Without an index, every option on the command-line is matched by walking
+ *  the whole options list. For programs with many options, build an index for
+ *  each sub-command once and list them in `clip->idx`. The parser makes no
+ *  memory allocation, so `keys` must be provided by the caller and must remain
+ *  valid as long as `idx` is in use. For example,
+ *
+ *  ```c
+ *      static struct cli_key keys[64];
+ *      static struct cli_index idx;
+ *
+ *      cli_index_build(&idx, &base_cmd, keys, 64);
+ *      clap.idx   = &idx;
+ *      clap.n_idx = 1;
+ *  ```
+ *
+ * \param idx
+ *      The index to fill
+ * \param cmd
+ *      The sub-command or default options to be indexed
+ * \param keys
+ *      Storage for at least `cli_index_keys(cmd)` long option and environment
+ *      variable keys
+ * \param n_keys
+ *      Number of entries in `keys`
+ *
+ * \returns CLIP_ERR_OK
+ *      On success
+ * \returns CLIP_ERR_INVALID
+ *      If any argument is NULL or `keys` is too small
+ */
+int cli_index_build(
+    struct cli_index *idx,
+    const struct cli_sub_cmd *cmd,
+    struct cli_key *keys,
+    size_t n_keys
+);
+
+/**
+ * \brief Number of `struct cli_cmd_key` entries needed to index sub-commands
+ *
+ * \param cmds
+ *      A ::CLI_CMD_END terminated list of sub-commands
+ *
+ * \returns
+ *      Count of sub-commands in `cmds` including all nested sub-commands
+ */
+size_t cli_cmd_index_keys(const struct cli_sub_cmd *cmds);
+
+/**
+ * \brief Build a sub-command lookup index
+ *
+ * \details
+ *  Without an index, sub-commands are matched by walking the list of
+ *  sub-commands. Programs with many sub-commands may build an index once and
+ *  set it in `clip->cmd_idx`, then each level of sub-commands is binary
+ *  searched instead.
+ *
+ * \param idx
+ *      The index to fill
+ * \param cmds
+ *      The list of sub-commands, usually the same as `clip->cmds`
+ * \param keys
+ *      Storage for at least `cli_cmd_index_keys(cmds)` keys
+ * \param n_keys
+ *      Number of entries in `keys`
+ *
+ * \returns CLIP_ERR_OK
+ *      On success
+ * \returns CLIP_ERR_INVALID
+ *      If any argument is NULL, a sub-command has no name or `keys` is too
+ *      small
+ */
+int cli_cmd_index_build(
+    struct cli_cmd_index *idx,
+    const struct cli_sub_cmd *cmds,
+    struct cli_cmd_key *keys,
+    size_t n_keys
+);
+
 /**
  * \brief Parse command-line arguments vector
  *
@@ -357,6 +1720,370 @@ void cli_verify(struct clip *clap);
  */
 int cli_parse(struct clip *clap, int argc, char **argv);
 
+/**
+ * \brief Set up the state for parsing against a definition
+ *
+ * \details
+ *  `usr`, `fbuf` and `toks` of the state are taken from `clap`, they may be
+ *  changed after, for example to give each parse its own. `srcs`, `files`
+ *  and `hold` are left empty for the caller to give, sized as it likes, so
+ *  arguments files can't be read until `srcs` is set. The same state can be
+ *  used for one parse after another.
+ *
+ * \param st
+ *      The state to set up
+ * \param clap
+ *      The command-line parser context, only read while parsing
+ *
+ * \returns CLIP_ERR_OK
+ *      On success
+ * \returns CLIP_ERR_INVALID
+ *      If any argument is NULL
+ */
+int cli_state_init(struct clip_state *st, const struct clip *clap);
+
+/**
+ * \brief Parse command-line arguments vector, keeping all state in `st`
+ *
+ * \details
+ *  Same as `cli_parse()`, except that the definition `st->clip` isn't changed,
+ *  so it can be shared with other parses, even those running at the same
+ *  time. On success or failure, `st->index` is set to the last argument that
+ *  was processed.
+ *
+ * \returns
+ *      Same as `cli_parse()`
+ */
+int cli_parse_r(struct clip_state *st, int argc, char **argv);
+
+/**
+ * \brief Parse a read-only command-line arguments vector
+ *
+ * \details
+ *  Same as `cli_parse_r()`. Neither this nor any other parse writes to the
+ *  arguments, `--key=value` is matched by the length of `key`, so `argv` may
+ *  be in read-only memory or shared by parses running at the same time.
+ *
+ * \returns
+ *      Same as `cli_parse()`
+ */
+int cli_parse_const(
+    struct clip_state *st,
+    int argc,
+    const char *const *argv
+);
+
+/**
+ * \brief Parse a command-line given as one string
+ *
+ * \details
+ *  Splits `len` bytes at `buf` into arguments the way a shell would, then
+ *  parses them as `cli_parse_r()` does, but there's no program name to skip.
+ *  Words are split at white space, `'...'` is taken as is, `"..."` allows
+ *  `\"` and `\\` escapes, and elsewhere `\` escapes the next character.
+ *
+ *  Nothing is allocated, the words are unquoted in place and packed with a
+ *  NUL after each at the start of `buf`, which is why `buf[len]` must be
+ *  writable too. Values given to call-backs point into `buf`.
+ *
+ * \returns
+ *      Same as `cli_parse()`, CLIP_ERR_BAD_ARG if a quote is left open
+ */
+int cli_parse_line(struct clip_state *st, char *buf, size_t len);
+
+/**
+ * \brief Start parsing command-line arguments one option at a time
+ *
+ * \details
+ *  Sub-commands are matched and -h/--help or -v/--version are looked for, as
+ *  `cli_parse()` would, then options are fetched with `cli_next()` instead of
+ *  being given to call-backs. `argv` must stay valid until `cli_end()`.
+ *
+ *  ```c
+ *      struct clip_state st;
+ *      struct cli_token tok;
+ *
+ *      cli_state_init(&st, &clap);
+ *      if ((r = cli_begin(&st, argc, argv)) != 0) {
+ *          return r;
+ *      }
+ *      while ((r = cli_next(&st, &tok)) == 0) {
+ *          // ...
+ *      }
+ *      cli_end(&st);
+ *  ```
+ *
+ * \returns CLIP_ERR_OK
+ *      On success
+ * \returns CLIP_ERR_HELP
+ *      Help/Version was requested on command-line and has been shown
+ * \returns CLIP_ERR_INVALID
+ *      If `st` is NULL or wasn't set up
+ */
+int cli_begin(struct clip_state *st, int argc, char **argv);
+
+/**
+ * \brief Same as `cli_begin()`, for a read-only arguments vector
+ */
+int cli_begin_const(
+    struct clip_state *st,
+    int argc,
+    const char *const *argv
+);
+
+/**
+ * \brief Same as `cli_begin()`, for a command-line given as one string
+ *
+ * \details
+ *  `buf` is split as `cli_parse_line()` does and must stay valid until
+ *  `cli_end()`.
+ */
+int cli_begin_line(struct clip_state *st, char *buf, size_t len);
+
+/**
+ * \brief Get the next parsed option
+ *
+ * \details
+ *  Matched sub-commands come first, with `tok->opt` set to NULL and
+ *  `tok->cmd` the sub-command. Each option after is given in `tok` with the
+ *  sub-command it was found in and its value, if any. Switches in a cluster,
+ *  such as `-abc`, each come as a separate option with the same `index`.
+ *  Options from arguments files are given as they're read, with `index` of
+ *  the `@file` argument. A value given by `tok` stays valid until
+ *  `cli_end()`, except one from an arguments file that couldn't be kept in
+ *  memory, which lasts only until the next call.
+ *
+ * \returns CLIP_ERR_OK
+ *      `tok` is filled
+ * \returns CLIP_ERR_END
+ *      No more options, either all arguments were parsed or `--` was found
+ * \returns CLIP_ERR_HELP
+ *      Help/Version was found on command-line, with ::CLIP_FLAG_SINGLE_PASS
+ * \returns CLIP_ERR_INVALID
+ *      If any argument is NULL
+ * \returns CLIP_ERR_BAD_ARG
+ *      Option did not match any in the registered options or is missing its
+ *      value
+ */
+int cli_next(struct clip_state *st, struct cli_token *tok);
+
+/**
+ * \brief Done parsing with `cli_next()`
+ *
+ * \details
+ *  Releases the arguments files read, values given out from them are no
+ *  longer valid after. This must be called once parsing with `cli_begin()` or
+ *  `cli_tokenize()` is over, whatever they or `cli_next()` returned.
+ */
+void cli_end(struct clip_state *st);
+
+/**
+ * \brief Parse command-line arguments vector into tokens
+ *
+ * \details
+ *  Works the same as `cli_parse_r()`, except that no call-backs are invoked.
+ *  Instead, the sub-commands and options, as `cli_next()` gives them, are
+ *  stored in `toks`. This allows the entire command-line to be checked before
+ *  acting on any of it, with `cli_dispatch()`. Values that wouldn't last are
+ *  copied to the top of `st->fbuf`. `cli_end()` must be called once done
+ *  with the tokens.
+ *
+ * \param st
+ *      The parse state, set up by `cli_state_init()`
+ * \param argc
+ *      Number of arguments in `argv`
+ * \param argv
+ *      Arguments vector, it must stay valid as long as `toks` is used
+ * \param toks
+ *      Storage for the tokens
+ * \param n_toks
+ *      Number of entries in `toks`
+ * \param count
+ *      Set to number of tokens stored, even on failure
+ *
+ * \returns CLIP_ERR_OK
+ *      On success
+ * \returns CLIP_ERR_HELP
+ *      Help/Version was requested on command-line
+ * \returns CLIP_ERR_INVALID
+ *      If any argument is NULL, the state wasn't set up or `toks` is too
+ *      small
+ * \returns CLIP_ERR_BAD_ARG
+ *      Option on command-line did not match any in the registered options, or
+ *      there's no room in `st->fbuf` to keep a value
+ */
+int cli_tokenize(
+    struct clip_state *st,
+    int argc,
+    char **argv,
+    struct cli_token *toks,
+    size_t n_toks,
+    size_t *count
+);
+
+/**
+ * \brief Invoke call-backs for tokens from `cli_tokenize()`
+ *
+ * \details
+ *  Call-backs are invoked in order for each option in `toks`, sub-commands
+ *  are skipped. It stops at the first call-back that fails. The same tokens
+ *  can be given again on the same state, and are dispatched just the same.
+ *
+ * \returns CLIP_ERR_OK
+ *      On success
+ * \returns CLIP_ERR_INVALID
+ *      If any argument is NULL
+ * \returns CLIP_ERR_CB_FAIL
+ *      Call-back did not return 0
+ */
+int cli_dispatch(
+    struct clip_state *st,
+    const struct cli_token *toks,
+    size_t n_toks
+);
+
+/**
+ * \brief Split the value of a list option into its elements
+ *
+ * \details
+ *  For options of ::CLI_OPT_LIST(), the `len` bytes of `value` are split in
+ *  one pass the same way as for call-backs. Each element points into `value`,
+ *  which need not be NUL terminated and is left as it is.
+ *
+ * \param opt
+ *      The list option the value is for
+ * \param value
+ *      The value, such as `cli_token::value`
+ * \param len
+ *      Length of `value` in bytes
+ * \param elems
+ *      Where to store the elements, may be NULL if `n` is 0
+ * \param n
+ *      Number of `elems`
+ *
+ * \returns
+ *      Number of elements in `value`, of which at most `n` are stored. 0 if
+ *      `opt` isn't a list or `value` is NULL.
+ */
+size_t cli_split(
+    const struct cli_opt *opt,
+    const char *value,
+    size_t len,
+    struct cli_elem *elems,
+    size_t n
+);
+
+/**
+ * \brief Number of `struct cli_seen` entries needed for a parse result
+ *
+ * \param clip
+ *      The Command Line Parser context
+ *
+ * \returns
+ *      Count of options of the base and of the sub-command, at any depth,
+ *      that has the most
+ */
+size_t cli_result_size(const struct clip *clip);
+
+/**
+ * \brief What was given of an option, once parsing is over
+ *
+ * \details
+ *  `opt` is an option of the sub-command selected, or of the base. It's
+ *  found by its place in the table, in constant time.
+ *
+ * \returns
+ *      The option's entry, or NULL if it wasn't given or isn't an option of
+ *      a table the parse used
+ */
+const struct cli_seen *cli_get(
+    const struct cli_result *res,
+    const struct cli_opt *opt
+);
+
+/**
+ * \brief Number of times an option was given, see `cli_get()`
+ */
+unsigned long cli_count(
+    const struct cli_result *res,
+    const struct cli_opt *opt
+);
+
+/**
+ * \brief Start parsing arguments that are fed one at a time
+ *
+ * \details
+ *  For arguments that come as they're read, from a pipe or socket say, so
+ *  they need not all be held in memory. Each is then given to `cli_feed()`
+ *  and call-backs are invoked for it before that returns. There's no program
+ *  name to skip, and with nothing to look ahead at, -h/--help and -v/--version
+ *  are acted on where they're found, as with ::CLIP_FLAG_SINGLE_PASS.
+ *
+ *  ```c
+ *      cli_state_init(&st, &clap);
+ *      cli_feed_begin(&st);
+ *      while ((n = read_arg(fd, arg, sizeof(arg))) > 0) {
+ *          if ((r = cli_feed(&st, arg, n)) != 0) {
+ *              break;
+ *          }
+ *      }
+ *      if (cli_feed_end(&st) != 0) {
+ *          // ...
+ *      }
+ *  ```
+ *
+ * \returns CLIP_ERR_OK
+ *      On success
+ * \returns CLIP_ERR_INVALID
+ *      If `st` is NULL or wasn't set up, or has no `fbuf` to copy arguments
+ *      into
+ */
+int cli_feed_begin(struct clip_state *st);
+
+/**
+ * \brief Parse the next argument, `len` bytes at `token`
+ *
+ * \details
+ *  Leading arguments are matched as sub-commands as `cli_parse()` would. An
+ *  option whose value is in the next argument waits for it, every other is
+ *  given to its call-back right away. The argument is copied to the top of
+ *  `fbuf`, so it need not be NUL terminated, but must be shorter than
+ *  ::CLIP_BUFFER_SIZE, or `fbuf` if that's smaller. A value is valid only
+ *  during its call-back. The name of an arguments file fed as `@file` is kept
+ *  below it, where there's room, to tell it apart from files fed later.
+ *
+ * \returns CLIP_ERR_OK
+ *      On success, feed the next argument
+ * \returns CLIP_ERR_END
+ *      `--` was fed, or parsing had already stopped. Nothing after is parsed
+ * \returns CLIP_ERR_HELP
+ *      Help/Version was fed and has been shown
+ * \returns CLIP_ERR_INVALID
+ *      If any argument is NULL or `cli_feed_begin()` wasn't called
+ * \returns CLIP_ERR_CB_FAIL
+ *      Call-back did not return 0
+ * \returns CLIP_ERR_BAD_ARG
+ *      Option did not match any in the registered options, or the argument
+ *      is too long
+ */
+int cli_feed(struct clip_state *st, const char *token, size_t len);
+
+/**
+ * \brief Done feeding arguments
+ *
+ * \details
+ *  Must be called once feeding is over, whatever `cli_feed()` returned. An
+ *  option still waiting for its value is then an error.
+ *
+ * \returns CLIP_ERR_OK
+ *      On success
+ * \returns CLIP_ERR_INVALID
+ *      If `cli_feed_begin()` wasn't called
+ * \returns CLIP_ERR_BAD_ARG
+ *      The last option fed is missing its value
+ */
+int cli_feed_end(struct clip_state *st);
+
 #ifdef __cplusplus
 }
 #endif
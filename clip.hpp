@@ -0,0 +1,567 @@
+/* SPDX-License-Identifier: ISC */
+#ifndef CLIP_HPP
+#define CLIP_HPP
+
+/*
+ * C++17 layer over clip.h. Option tables are defined and checked at compile
+ * time, their long names perfectly hashed, and call-backs dispatched to a
+ * handler of each option that the compiler is free to inline. Parsing itself
+ * is still done by the C library, which is only given what's made here:
+ *
+ *      static constexpr auto opts = cli::make_options(
+ *          cli::opt_switch('v', "verbose", "Say more"),
+ *          cli::opt_value('o', "output", "FILE", "Where to write"),
+ *          cli::opt_nargs("FILE", "Files to read")
+ *      );
+ *      static_assert(cli::verify(opts), "options are not unique");
+ *
+ *      static constexpr auto on_opts = cli::make_handlers(
+ *          [](const clip_state *st, const char *, std::size_t) { ... },
+ *          [](const clip_state *st, const char *v, std::size_t n) { ... },
+ *          cli::ignore
+ *      );
+ *
+ *      static constexpr cli_sub_cmd base = cli::make_cmd(nullptr, opts);
+ *      static constexpr cli_index idx[] = { cli::make_index<opts>(base) };
+ *
+ *      clap.base  = &base;
+ *      clap.idx   = idx;
+ *      clap.n_idx = 1;
+ *      clap.cbn   = cli::dispatch<opts, on_opts>;
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "clip.h"
+
+namespace cli {
+
+namespace detail {
+
+constexpr std::size_t length(const char *str)
+{
+    std::size_t n = 0;
+
+    while (str[n] != 0) {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Same order as cli_index_build() sorts keys in, bytes then length.
+ */
+constexpr int compare(
+    const char *a,
+    std::size_t a_len,
+    const char *b,
+    std::size_t b_len)
+{
+    for (std::size_t i = 0; i < a_len && i < b_len; i++) {
+        if (a[i] != b[i]) {
+            return (static_cast<unsigned char>(a[i]) <
+                    static_cast<unsigned char>(b[i]))? -1: 1;
+        }
+    }
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+/**
+ * FNV-1a with its basis moved by `seed`, then mixed so that each seed spreads
+ * the same names differently.
+ */
+constexpr std::uint32_t hash(const char *str, std::size_t n, std::uint32_t seed)
+{
+    std::uint32_t h = 2166136261u + seed * 0x9E3779B9u;
+
+    for (std::size_t i = 0; i < n; i++) {
+        h ^= static_cast<unsigned char>(str[i]);
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+
+    return h;
+}
+
+/**
+ * Slots of the hash for `n` names, a power of two at most half full.
+ */
+constexpr std::size_t slots(std::size_t n)
+{
+    std::size_t m = 1;
+
+    while (m < 2 * n) {
+        m <<= 1;
+    }
+    return m;
+}
+
+constexpr bool is_nargs(const cli_opt &opt)
+{
+    return (opt.mode & 0x02u) != 0;
+}
+
+} /* namespace detail */
+
+/**
+ * \brief A table of `N` options, ending with ::CLI_OPT_END() like C ones
+ *
+ * \details
+ *  Long names are hashed with no collisions, by hash and displace: names
+ *  are put in buckets by one hash, and each bucket is given the seed of a
+ *  second hash that puts all its names in free slots. Looking a name up is
+ *  then two hashes and one compare. Use make_options() to define one.
+ */
+template <std::size_t N>
+struct options {
+    static_assert(N < 32768, "Too many options for a table");
+
+    static constexpr std::size_t n_slots   = detail::slots(N);
+    static constexpr std::size_t n_buckets = N / 2 + 1;
+
+    cli_opt opts[N + 1];
+    std::uint16_t seeds[n_buckets];
+    short slot[n_slots];
+    bool hashed;
+
+    constexpr std::size_t size() const
+    {
+        return N;
+    }
+
+    /**
+     * Index of the option with long name `name` of `len` bytes, or -1
+     */
+    constexpr int find(const char *name, std::size_t len) const
+    {
+        std::uint32_t b = detail::hash(name, len, 0) % n_buckets;
+        std::uint32_t h = detail::hash(name, len, seeds[b]);
+        int i = slot[h & (n_slots - 1)];
+
+        if (i < 0 || detail::length(opts[i].a_long) != len ||
+            detail::compare(opts[i].a_long, len, name, len) != 0) {
+            return -1;
+        }
+        return i;
+    }
+
+    constexpr int find(const char *name) const
+    {
+        return find(name, detail::length(name));
+    }
+};
+
+namespace detail {
+
+/**
+ * Fill in the perfect hash of `t`, biggest buckets first while there are
+ * most slots free. `t.hashed` is left false if no seed fits a bucket.
+ */
+template <std::size_t N>
+constexpr void build_hash(options<N> &t)
+{
+    constexpr std::size_t n_buckets = options<N>::n_buckets;
+    constexpr std::size_t mask      = options<N>::n_slots - 1;
+    std::size_t bucket[N + 1] = {};
+    std::size_t count[n_buckets + 1] = {};
+    std::size_t start[n_buckets + 1] = {};
+    std::size_t order[N + 1] = {};
+    std::size_t fill[n_buckets + 1] = {};
+    std::size_t most = 0;
+
+    for (std::size_t s = 0; s <= mask; s++) {
+        t.slot[s] = -1;
+    }
+    for (std::size_t b = 0; b < n_buckets; b++) {
+        t.seeds[b] = 0;
+    }
+
+    /* Options in order of bucket, from where each bucket starts */
+    for (std::size_t i = 0; i < N; i++) {
+        const cli_opt &opt = t.opts[i];
+
+        bucket[i] = n_buckets;
+        if (opt.a_long != nullptr && !is_nargs(opt)) {
+            bucket[i] = hash(opt.a_long, length(opt.a_long), 0) % n_buckets;
+            count[bucket[i]]++;
+        }
+    }
+    for (std::size_t b = 0; b < n_buckets; b++) {
+        start[b + 1] = start[b] + count[b];
+        most = (count[b] > most)? count[b]: most;
+    }
+    for (std::size_t i = 0; i < N; i++) {
+        if (bucket[i] < n_buckets) {
+            order[start[bucket[i]] + fill[bucket[i]]++] = i;
+        }
+    }
+
+    /* The same name twice would never hash apart */
+    for (std::size_t b = 0; b < n_buckets; b++) {
+        for (std::size_t k = 1; k < count[b]; k++) {
+            const char *name = t.opts[order[start[b] + k]].a_long;
+
+            for (std::size_t j = 0; j < k; j++) {
+                const char *other = t.opts[order[start[b] + j]].a_long;
+
+                if (compare(name, length(name), other, length(other)) == 0) {
+                    return;
+                }
+            }
+        }
+    }
+
+    for (std::size_t want = most; want > 0; want--) {
+        for (std::size_t b = 0; b < n_buckets; b++) {
+            if (count[b] != want) {
+                continue;
+            }
+
+            std::uint32_t seed = 1;
+            for (; seed < 0x10000u; seed++) {
+                std::size_t k = 0;
+
+                for (; k < want; k++) {
+                    const cli_opt &opt = t.opts[order[start[b] + k]];
+                    std::size_t s =
+                        hash(opt.a_long, length(opt.a_long), seed) & mask;
+
+                    if (t.slot[s] >= 0) {
+                        break;
+                    }
+                    t.slot[s] = static_cast<short>(order[start[b] + k]);
+                }
+                if (k == want) {
+                    break;
+                }
+
+                /* Take back what was put of this bucket */
+                while (k-- > 0) {
+                    const cli_opt &opt = t.opts[order[start[b] + k]];
+                    t.slot[hash(opt.a_long, length(opt.a_long), seed) & mask] =
+                        -1;
+                }
+            }
+            if (seed == 0x10000u) {
+                return;
+            }
+            t.seeds[b] = static_cast<std::uint16_t>(seed);
+        }
+    }
+
+    t.hashed = true;
+}
+
+/**
+ * Long names of a table as sorted keys, the same as cli_index_build() makes,
+ * or with `env` the names of environment variables.
+ */
+template <std::size_t N>
+struct keys {
+    cli_key k[N + 1];
+    std::size_t n;
+};
+
+template <std::size_t N>
+constexpr keys<N> sort_keys(const options<N> &t, bool env)
+{
+    keys<N> ks{};
+
+    for (std::size_t i = 0; i < N; i++) {
+        const cli_opt &opt = t.opts[i];
+        const char *env_name = (opt.ext != nullptr)? opt.ext->env: nullptr;
+        const char *name = env? env_name: opt.a_long;
+
+        if (name == nullptr || (!env && is_nargs(opt))) {
+            continue;
+        }
+
+        /* Insertion sort, the first defined staying first */
+        std::size_t j = ks.n++;
+        std::size_t len = length(name);
+        for (; j > 0 && compare(ks.k[j - 1].name, ks.k[j - 1].len,
+                                name, len) > 0; j--) {
+            ks.k[j] = ks.k[j - 1];
+        }
+        ks.k[j].name = name;
+        ks.k[j].len  = len;
+        ks.k[j].opt  = &opt;
+    }
+
+    return ks;
+}
+
+template <const auto &Opts>
+inline constexpr auto sorted = sort_keys(Opts, false);
+
+template <const auto &Opts>
+inline constexpr auto sorted_envs = sort_keys(Opts, true);
+
+template <const auto &Opts>
+const cli_opt *find_long(
+    const cli_index *idx,
+    const char *name,
+    std::size_t len)
+{
+    int i = Opts.find(name, len);
+
+    (void)idx;
+    return (i < 0)? nullptr: &Opts.opts[i];
+}
+
+} /* namespace detail */
+
+/**
+ * \brief Define a switch option, see ::CLI_OPT_SWITCH_ATTR()
+ */
+constexpr cli_opt opt_switch(
+    int a_short,
+    const char *a_long,
+    const char *help,
+    unsigned attr = 0)
+{
+    return cli_opt CLI_OPT_SWITCH_ATTR(a_short, a_long, help, attr);
+}
+
+/**
+ * \brief Define an option that takes a value, see ::CLI_OPT_VALUE_ATTR()
+ */
+constexpr cli_opt opt_value(
+    int a_short,
+    const char *a_long,
+    const char *tag,
+    const char *help,
+    unsigned attr = 0)
+{
+    return cli_opt CLI_OPT_VALUE_ATTR(a_short, a_long, tag, help, attr);
+}
+
+/**
+ * \brief Define an option whose value is a list, see ::CLI_OPT_LIST()
+ */
+constexpr cli_opt opt_list(
+    int a_short,
+    const char *a_long,
+    const char *tag,
+    const char *help,
+    char sep)
+{
+    return cli_opt CLI_OPT_LIST(a_short, a_long, tag, help, sep);
+}
+
+/**
+ * \brief Define the option for positional arguments, see ::CLI_OPT_NARGS()
+ */
+constexpr cli_opt opt_nargs(const char *tag, const char *help)
+{
+    return cli_opt CLI_OPT_NARGS(tag, help);
+}
+
+/**
+ * \brief Define a table of options, the end of it is added
+ *
+ * \details
+ *  Any `cli_opt` may be given, such as `cli_opt CLI_OPT_INT(...)` for typed
+ *  options.
+ */
+template <typename... O>
+constexpr options<sizeof...(O)> make_options(const O &...opts)
+{
+    static_assert(
+        (std::is_same<O, cli_opt>::value && ...),
+        "Options must be of struct cli_opt"
+    );
+
+    options<sizeof...(O)> t{
+        { opts..., cli_opt CLI_OPT_END() }, {}, {}, false
+    };
+    detail::build_hash(t);
+    return t;
+}
+
+/**
+ * \brief Check a table at compile time, as cli_verify() would at run time
+ *
+ * \details
+ *  Short and long names must be unique, options that take values must name
+ *  them with a tag and there's at most one ::CLI_OPT_NARGS(). Use it as
+ *  `static_assert(cli::verify(opts), "...")`. Long names that aren't unique
+ *  are those the perfect hash couldn't be made of.
+ */
+template <std::size_t N>
+constexpr bool verify(const options<N> &t)
+{
+    bool shorts[256] = {};
+    std::size_t anys = 0;
+
+    for (std::size_t i = 0; i < N; i++) {
+        const cli_opt &opt = t.opts[i];
+
+        if (detail::is_nargs(opt)) {
+            if (opt.a_short != 0 || opt.a_long != nullptr ||
+                opt.tag == nullptr || ++anys > 1) {
+                return false;
+            }
+            continue;
+        } else if ((opt.mode & 0x01u) != 0 && opt.tag == nullptr) {
+            return false;
+        } else if (opt.a_short == 0 && opt.a_long == nullptr) {
+            return false;
+        }
+
+        if (opt.a_short > 0 && unsigned(opt.a_short) < 256) {
+            if (shorts[opt.a_short]) {
+                return false;
+            }
+            shorts[opt.a_short] = true;
+        }
+    }
+
+    return t.hashed;
+}
+
+/**
+ * \brief Define a sub-command, or the base with a NULL `name`, optionally
+ * with a handler for its options, see ::CLI_CMD_CB()
+ */
+template <std::size_t N>
+constexpr cli_sub_cmd make_cmd(
+    const char *name,
+    const options<N> &t,
+    const cli_sub_cmd *cmds = nullptr,
+    clap_cbn cb = nullptr)
+{
+#ifdef CLIP_PACKED
+    return cli_sub_cmd{ name, t.opts, cmds, cb, (unsigned short)N };
+#else
+    return cli_sub_cmd{ name, t.opts, cmds, cb };
+#endif
+}
+
+/**
+ * \brief Index of sub-command `cmd` whose options are `Opts`, see
+ * `cli_index_build()`
+ *
+ * \details
+ *  Everything is worked out at compile time, and long options are found by
+ *  the perfect hash of `Opts`.
+ */
+template <const auto &Opts>
+constexpr cli_index make_index(const cli_sub_cmd &cmd)
+{
+    cli_index idx{};
+
+    idx.cmd = &cmd;
+    for (std::size_t i = 0; i < Opts.size(); i++) {
+        const cli_opt &opt = Opts.opts[i];
+
+        if (!detail::is_nargs(opt) && opt.a_short > 0 &&
+            unsigned(opt.a_short) < 256 &&
+            idx.shorts[opt.a_short] == nullptr) {
+            idx.shorts[opt.a_short] = &opt;
+        }
+    }
+    idx.keys   = detail::sorted<Opts>.k;
+    idx.n_keys = detail::sorted<Opts>.n;
+    idx.find   = &detail::find_long<Opts>;
+    idx.envs   = detail::sorted_envs<Opts>.k;
+    idx.n_envs = detail::sorted_envs<Opts>.n;
+
+    return idx;
+}
+
+/**
+ * \brief A handler for each option of a table, in the same order
+ *
+ * \details
+ *  Each is invoked as `int (const clip_state *st, const char *value,
+ *  std::size_t len)`, returning non-zero to fail parsing as a call-back
+ *  would. Use make_handlers() to define them.
+ */
+template <typename... H>
+struct handlers {
+    std::tuple<H...> h;
+
+    template <std::size_t... I>
+    int call(
+        std::index_sequence<I...>,
+        std::size_t i,
+        const clip_state *st,
+        const char *value,
+        std::size_t len) const
+    {
+        int r = 0;
+
+        (void)((i == I && ((r = std::get<I>(h)(st, value, len)), true)) ||
+               ...);
+        return r;
+    }
+};
+
+template <typename... H>
+constexpr handlers<H...> make_handlers(H... h)
+{
+    return handlers<H...>{ std::tuple<H...>(h...) };
+}
+
+/**
+ * \brief Handler for options that don't need one, such as typed ones
+ */
+inline constexpr auto ignore =
+    [](const clip_state *, const char *, std::size_t) { return 0; };
+
+/**
+ * \brief A ::clap_cbn call-back that invokes the handler of an option
+ *
+ * \details
+ *  Options that aren't of `Opts` are given to `Next`, if set, so that
+ *  tables of the base and sub-commands can be chained:
+ *
+ *      clap.cbn = cli::dispatch<
+ *          base_opts, on_base, cli::dispatch<run_opts, on_run>>;
+ */
+template <const auto &Opts, const auto &Handlers, clap_cbn Next = nullptr>
+int dispatch(
+    const clip_state *st,
+    const cli_sub_cmd *cmd,
+    const cli_opt *opt,
+    const char *value,
+    std::size_t len)
+{
+    constexpr std::size_t n = Opts.size();
+    std::less<const cli_opt *> before;
+
+    static_assert(
+        std::tuple_size<std::decay_t<decltype(Handlers.h)>>::value == n,
+        "There must be a handler for each option"
+    );
+
+    if (opt == nullptr || before(opt, Opts.opts) ||
+        !before(opt, Opts.opts + n)) {
+        if constexpr (Next != nullptr) {
+            return Next(st, cmd, opt, value, len);
+        }
+        return 0;
+    }
+
+    return Handlers.call(
+        std::make_index_sequence<n>(),
+        static_cast<std::size_t>(opt - Opts.opts),
+        st,
+        value,
+        len
+    );
+}
+
+} /* namespace cli */
+
+#endif /* CLIP_HPP */